@@ -37,6 +37,8 @@ StatsMessage send_command(const char* socket_path, MessageType type, int x, int
   Message msg;
   memset(&msg, 0, sizeof(msg));
   msg.type = type; msg.x = x; msg.y = y;
+  client_view_size(&msg.view_w, &msg.view_h);
+  msg.display = client_display_type();
   
   if (write(fd, &msg, sizeof(msg)) < 0) {
     close(fd);
@@ -149,10 +151,17 @@ void client_run(void) {
 
   int mode = 0;
   int x = 5, y = 5, K = 100, runs = 1;
-  int probs[4] = {25, 25, 25, 25};
+  double probs[4] = {25, 25, 25, 25};
   int height = 11, width = 11;
   char out_filename[128] = {0};
+  char world_filename[128] = {0};
   double obstacle_ratio = 0.0;
+  // polosirka uspesnosti, polosirka krokov, casovy limit; 0 = vypnute
+  double adaptive[3] = {0, 0, 0};
+  // sekundy medzi checkpointmi davky, 0 = vypnute
+  double checkpoint_interval = 60;
+  // presne hodnoty aj na velkom svete
+  int exact = 0;
 
   pthread_t receiver_tid, input_tid;
   pthread_create(&receiver_tid, NULL, receiver_thread_func, &ctx);
@@ -195,7 +204,7 @@ void client_run(void) {
 
     case UI_SETUP_SIM: {
       timeout(-1);  
-      UIState next = draw_setup(&x, &y, &K, &runs,&width, &height,probs, mode,out_filename, sizeof(out_filename), &obstacle_ratio);
+      UIState next = draw_setup(&x, &y, &K, &runs,&width, &height,probs, mode,out_filename, sizeof(out_filename), world_filename, sizeof(world_filename), &obstacle_ratio, adaptive, &checkpoint_interval, &exact);
 
       if (next == UI_SETUP_SIM) {
         break; 
@@ -208,7 +217,7 @@ void client_run(void) {
         break;
       }
 
-      int success = send_config_to_server(&ctx,x, y,width, height,K, runs,probs,out_filename,obstacle_ratio,&next);
+      int success = send_config_to_server(&ctx,x, y,width, height,K, runs,probs,out_filename,world_filename,obstacle_ratio,adaptive,checkpoint_interval,exact,&next);
 
       if (!success) {
         pthread_mutex_lock(&ctx.mutex);
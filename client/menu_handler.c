@@ -40,7 +40,7 @@ int wait_for_server(const char *socket_path, int max_retries) {
 }
 
 
-  int send_config_to_server(ClientContext *ctx,int x, int y,int width, int height,int K, int runs,int *probs,const char *out_filename,double obstacle_ratio,UIState *next_state) {
+  int send_config_to_server(ClientContext *ctx,int x, int y,int width, int height,int K, int runs,double *probs,const char *out_filename,const char *world_filename,double obstacle_ratio,const double adaptive[3],double checkpoint_interval,int exact,UIState *next_state) {
   int fd = socket(AF_UNIX, SOCK_STREAM, 0);
   if (fd < 0) {
     show_error_dialog("Nie je mozne vytvorit socket!");
@@ -68,11 +68,20 @@ int wait_for_server(const char *socket_path, int max_retries) {
   configMsg.max_steps = K;
   configMsg.replications = runs;
   configMsg.obstacle_ratio = obstacle_ratio;
+  configMsg.ci_rate = adaptive[0];
+  configMsg.ci_steps = adaptive[1];
+  configMsg.time_limit = adaptive[2];
+  configMsg.checkpoint_interval = checkpoint_interval;
+  configMsg.exact = exact;
+  client_view_size(&configMsg.view_w, &configMsg.view_h);
   memcpy(configMsg.probs, probs, sizeof(configMsg.probs));
   if (out_filename && out_filename[0] != '\0') {
     strncpy(configMsg.out_filename, out_filename, sizeof(configMsg.out_filename) - 1);
     configMsg.out_filename[sizeof(configMsg.out_filename) - 1] = '\0';
   }
+  if (world_filename && world_filename[0] != '\0') {
+    snprintf(configMsg.world_filename, sizeof(configMsg.world_filename), "%s", world_filename);
+  }
 
   if (write(fd, &configMsg, sizeof(configMsg)) <= 0) {
     close(fd);
@@ -89,6 +98,13 @@ int wait_for_server(const char *socket_path, int max_retries) {
     got += r;
   }
 
+  // prazdne potvrdenie: server konfiguraciu odmietol, bezi predosla simulacia
+  if (got < sizeof(temp_stats) || temp_stats.width <= 0) {
+    close(fd);
+    show_error_dialog("Server konfiguraciu odmietol!");
+    return 0;
+  }
+
   pthread_mutex_lock(&ctx->mutex);
   ctx->stats = temp_stats;
   ctx->current_state = *next_state;
@@ -6,7 +6,7 @@
 UIState handle_create_new_server(ClientContext *ctx,char *room_code,int *mode);
 UIState handle_connect_to_existing(ClientContext *ctx);
 int wait_for_server(const char *socket_path, int max_retries);
-int send_config_to_server(ClientContext *ctx,int x, int y,int width, int height,int K, int runs,int *probs,const char *out_filename,double obstacle_ratio,UIState *next_state);
+int send_config_to_server(ClientContext *ctx,int x, int y,int width, int height,int K, int runs,double *probs,const char *out_filename,const char *world_filename,double obstacle_ratio,const double adaptive[3],double checkpoint_interval,int exact,UIState *next_state);
 void show_error_dialog(const char *message);
 
 #endif
@@ -47,34 +47,20 @@ void handle_interactive_mode(
     mvprintw(5, 0, "");
     
     // ===== VYKRESLI SVET =====
-    int world_height = current_stats->height;
-    int world_width = current_stats->width;
-    draw_world(
-        world_height,
-        world_width,
-        current_stats->posX,
-        current_stats->posY,
-        current_stats->obstacle,
-        current_stats->visited
-    );
+    draw_world(current_stats);
     
     // ===== ŠTATISTIKY (pod svetom) =====
     // Riadky 0-5: header (6 riadkov)
     // Riadky 5-17: grid s top+world_height+bottom
     // Riadky 19+: štatistiky
-    int stats_y = 6 + 1 + world_height + 1;
+    int stats_y = 6 + 1 + current_stats->view_h + 1;
     
     mvprintw(stats_y, 0, "[--- STATISTIKY ---]                 ");
     mvprintw(stats_y + 1, 0, "Kroky:       %3d / %d             ", current_stats->curr_steps, K);
     mvprintw(stats_y + 2, 0, "Pozicia:     [%d, %d]              ", current_stats->posX, current_stats->posY);
     
-    int visited_count = 0;
-    for (int y_i = 0; y_i < world_height; y_i++) {
-        for (int x_i = 0; x_i < world_width; x_i++) {
-            if (current_stats->visited[y_i][x_i]) visited_count++;
-        }
-    }
-    mvprintw(stats_y + 3, 0, "Navstivene:  %d / %d buniek        ", visited_count, world_width * world_height);
+    long long cells = (long long)current_stats->width * current_stats->height;
+    mvprintw(stats_y + 3, 0, "Navstivene:  %lld / %lld buniek        ", (long long)current_stats->visited_count, cells);
     mvprintw(stats_y + 4, 0, "[-------------------]               ");
     
     refresh();
@@ -111,13 +97,13 @@ void handle_summary_mode(
     mvprintw(2, 0, "========================================");
     
     mvprintw(3, 0, "Start: [%d,%d]  |  Ciel: [0,0]       ", x, y);
-    mvprintw(4, 0, "Klávesy: [r]=spustit  [q]=menu");
+    mvprintw(4, 0, "Klávesy: [r]=spustit  [h]=mapa  [m]=kroky/uspesnost  [q]=menu");
     mvprintw(5, 0, "");
     
     // ===== ŠTATISTIKY =====
     mvprintw(7, 0, "[--- VYSLEDKY ---]                  ");
-    mvprintw(8, 0, "Celkove behy:    %d behov           ", current_stats->total_runs);
-    mvprintw(9, 0, "Uspesne behy:    %d behov           ", current_stats->succ_runs);
+    mvprintw(8, 0, "Celkove behy:    %lld behov           ", (long long)current_stats->total_runs);
+    mvprintw(9, 0, "Uspesne behy:    %lld behov           ", (long long)current_stats->succ_runs);
     mvprintw(10, 0, "Uspesnost:       %.2f %%            ", current_stats->success_rate_permille / 10.0f);
     
     if (current_stats->total_runs > 0) {
@@ -128,7 +114,38 @@ void handle_summary_mode(
     }
     
     mvprintw(12, 0, "Zostavajuce:     %d behov           ", current_stats->remaining_runs);
-    mvprintw(13, 0, "[-------------------]               ");
+    if (current_stats->total_runs >= 2) {
+        mvprintw(13, 0, "Presnost 95%%:    +-%.2f %% / +-%.2f krokov      ",
+                 current_stats->ci_rate * 100.0, current_stats->ci_steps);
+    } else {
+        mvprintw(13, 0, "Presnost 95%%:    -                              ");
+    }
+    if (current_stats->succ_runs > 0) {
+        mvprintw(14, 0, "Kroky do ciela:  p50 %lld  p90 %lld  p99 %lld        ", (long long)current_stats->p50,
+                 (long long)current_stats->p90, (long long)current_stats->p99);
+    } else {
+        mvprintw(14, 0, "Kroky do ciela:  -                                  ");
+    }
+    // presne hodnoty z Markovovho retazca na porovnanie s riadkami vyssie
+    if (current_stats->exact_distribution) {
+        mvprintw(15, 0, "Presne (Markov): %.2f %%  priemer %.2f  E[T] %.2f        ",
+                 current_stats->exact_rate * 100.0, current_stats->exact_mean_steps, current_stats->exact_hitting_time);
+        mvprintw(16, 0, "Presne kroky:    p50 %lld  p90 %lld  p99 %lld        ", (long long)current_stats->exact_p50,
+                 (long long)current_stats->exact_p90, (long long)current_stats->exact_p99);
+    } else if (current_stats->exact) {
+        mvprintw(15, 0, "Presne (Markov): E[T] %.2f krokov                  ", current_stats->exact_hitting_time);
+        mvprintw(16, 0, "Presne kroky:    -                                  ");
+    } else {
+        mvprintw(15, 0, "Presne (Markov): -                                 ");
+        mvprintw(16, 0, "Presne kroky:    -                                  ");
+    }
+    if (current_stats->output_failed) {
+        mvprintw(17, 0, "[--- ZAPIS VYSTUPU ZLYHAL ---]       ");
+    } else {
+        mvprintw(17, 0, "[-------------------]               ");
+    }
+
+    draw_heatmap(current_stats, 19);
     
     refresh();
     timeout(50);
@@ -137,6 +154,10 @@ void handle_summary_mode(
     
     if (ch == 'r') {
         send_command(ctx->active_socket_path, MSG_SIM_RUN, x, y);
+    } else if (ch == 'h') {
+        send_command(ctx->active_socket_path, MSG_SIM_SWEEP, x, y);
+    } else if (ch == 'm') {
+        client_toggle_display();
     } else if (ch == 'q') {
         initialized = 0;
         pthread_mutex_lock(&ctx->mutex);
@@ -1,5 +1,6 @@
 #include "../common/common.h"
 #include "../common/ipc.h"
+#include "../common/types.h"
 
 #include <ncurses.h>
 #include <stdlib.h>
@@ -63,13 +64,18 @@ UIState draw_mode_menu(int *mode) {
 UIState draw_setup(
     int *x, int *y, int *K, int *runs,
     int *width, int *height,
-    int probs[4], int mode,
+    double probs[4], int mode,
     char *out_filename, int out_filename_len,
-    double *obstacle_ratio  // ✅ NOVÉ
+    char *world_filename, int world_filename_len,
+    double *obstacle_ratio,  // ✅ NOVÉ
+    double adaptive[3],
+    double *checkpoint_interval,
+    int *exact
 ) {
     enum { F_WIDTH, F_HEIGHT, F_X, F_Y,
             F_UP, F_DOWN, F_LEFT, F_RIGHT,
-            F_K, F_RUNS, F_OBSTACLE, F_FILENAME, F_COUNT };  // ✅ F_OBSTACLE pridané
+            F_K, F_RUNS, F_OBSTACLE, F_FILENAME, F_WORLDFILE,
+            F_CI_RATE, F_CI_STEPS, F_TIME_LIMIT, F_CHECKPOINT, F_EXACT, F_COUNT };  // ✅ F_OBSTACLE pridané
 
     static int field = 0;
     static char buf[F_COUNT][64];
@@ -80,14 +86,20 @@ UIState draw_setup(
         snprintf(buf[F_HEIGHT], 8, "%d", *height);
         snprintf(buf[F_X], 8, "%d", *x);
         snprintf(buf[F_Y], 8, "%d", *y);
-        snprintf(buf[F_UP], 8, "%d", probs[0]);
-        snprintf(buf[F_DOWN], 8, "%d", probs[1]);
-        snprintf(buf[F_LEFT], 8, "%d", probs[2]);
-        snprintf(buf[F_RIGHT], 8, "%d", probs[3]);
+        snprintf(buf[F_UP], sizeof(buf[F_UP]), "%g", probs[0]);
+        snprintf(buf[F_DOWN], sizeof(buf[F_DOWN]), "%g", probs[1]);
+        snprintf(buf[F_LEFT], sizeof(buf[F_LEFT]), "%g", probs[2]);
+        snprintf(buf[F_RIGHT], sizeof(buf[F_RIGHT]), "%g", probs[3]);
         snprintf(buf[F_K], 8, "%d", *K);
         snprintf(buf[F_RUNS], 8, "%d", *runs);
         snprintf(buf[F_OBSTACLE], 8, "%.1f", *obstacle_ratio);  // ✅ NOVÉ
         snprintf(buf[F_FILENAME], 64, "out. txt");
+        buf[F_WORLDFILE][0] = '\0';
+        snprintf(buf[F_CI_RATE], sizeof(buf[F_CI_RATE]), "%g", adaptive[0] * 100.0);
+        snprintf(buf[F_CI_STEPS], sizeof(buf[F_CI_STEPS]), "%g", adaptive[1]);
+        snprintf(buf[F_TIME_LIMIT], sizeof(buf[F_TIME_LIMIT]), "%g", adaptive[2]);
+        snprintf(buf[F_CHECKPOINT], sizeof(buf[F_CHECKPOINT]), "%g", *checkpoint_interval);
+        snprintf(buf[F_EXACT], sizeof(buf[F_EXACT]), "%d", *exact);
         initialized = 1;
     }
 
@@ -114,7 +126,20 @@ UIState draw_setup(
         mvprintw(17, 2, "Vystupny subor: %s %s", buf[F_FILENAME], field == F_FILENAME ?  "<" : "");
     }
 
-    mvprintw(18, 2, "ENTER = dalsie | BACKSPACE = mazat | q = spat");
+    mvprintw(18, 2, "Subor sveta (prazdne = nahodny): %s %s", buf[F_WORLDFILE], field == F_WORLDFILE ? "<" : "");
+
+    // 0 = pevny pocet replikacii
+    mvprintw(20, 2, "Presnost uspesnosti +- %%: %s %s                    ", buf[F_CI_RATE], field == F_CI_RATE ? "<" : "");
+    mvprintw(21, 2, "Presnost priemeru krokov +-: %s %s                 ", buf[F_CI_STEPS], field == F_CI_STEPS ? "<" : "");
+    mvprintw(22, 2, "Casovy limit s: %s %s                              ", buf[F_TIME_LIMIT], field == F_TIME_LIMIT ? "<" : "");
+
+    // davka so suborom sa po pade obnovi z checkpointu
+    mvprintw(23, 2, "Checkpoint kazdych s: %s %s                         ", buf[F_CHECKPOINT], field == F_CHECKPOINT ? "<" : "");
+
+    // presne hodnoty sa na velkom svete pocitaju len na ziadost
+    mvprintw(24, 2, "Presne hodnoty aj na velkom svete (0/1): %s %s     ", buf[F_EXACT], field == F_EXACT ? "<" : "");
+
+    mvprintw(26, 2, "ENTER = dalsie | BACKSPACE = mazat | q = spat");
 
     refresh();
     timeout(50);
@@ -133,18 +158,26 @@ UIState draw_setup(
             *height = atoi(buf[F_HEIGHT]);
             *x = atoi(buf[F_X]);
             *y = atoi(buf[F_Y]);
-            probs[0] = atoi(buf[F_UP]);
-            probs[1] = atoi(buf[F_DOWN]);
-            probs[2] = atoi(buf[F_LEFT]);
-            probs[3] = atoi(buf[F_RIGHT]);
+            probs[0] = atof(buf[F_UP]);
+            probs[1] = atof(buf[F_DOWN]);
+            probs[2] = atof(buf[F_LEFT]);
+            probs[3] = atof(buf[F_RIGHT]);
             *K = atoi(buf[F_K]);
             *obstacle_ratio = atof(buf[F_OBSTACLE]);  // ✅ NOVÉ
             *runs = atoi(buf[F_RUNS]);
+            adaptive[0] = atof(buf[F_CI_RATE]) / 100.0;
+            adaptive[1] = atof(buf[F_CI_STEPS]);
+            adaptive[2] = atof(buf[F_TIME_LIMIT]);
+            *checkpoint_interval = atof(buf[F_CHECKPOINT]);
+            *exact = atoi(buf[F_EXACT]) != 0;
         
             if (out_filename && out_filename_len > 0) {
                 strncpy(out_filename, buf[F_FILENAME], out_filename_len - 1);
                 out_filename[out_filename_len-1] = '\0';
             }
+            if (world_filename && world_filename_len > 0) {
+                snprintf(world_filename, world_filename_len, "%s", buf[F_WORLDFILE]);
+            }
 
             initialized = 0;
             field = 0;
@@ -157,7 +190,7 @@ UIState draw_setup(
         if (len > 0) buf[field][len - 1] = '\0';
     }
 
-    if (field == F_FILENAME) {
+    if (field == F_FILENAME || field == F_WORLDFILE) {
         if (ch >= 32 && ch <= 126) {
             int len = strlen(buf[field]);
             if (len < 63) {
@@ -174,7 +207,7 @@ UIState draw_setup(
             }
         }
         // ✅ Povolíme aj '.' pre desatinné čísla (obstacle_ratio)
-        if ((field == F_OBSTACLE) && ch == 46 && strlen(buf[field]) < 6) {
+        if ((field == F_OBSTACLE || (field >= F_UP && field <= F_RIGHT) || field >= F_CI_RATE) && ch == 46 && strlen(buf[field]) < 6) {
             int len = strlen(buf[field]);
             buf[field][len] = ch;
             buf[field][len + 1] = '\0';
@@ -183,12 +216,24 @@ UIState draw_setup(
 
     return UI_SETUP_SIM;
 }
-void draw_world(int height, int width, int posX, int posY, _Bool obstacle[50][50], _Bool visited[50][50]) {
+// kolko buniek sa zmesti na obrazovku: 4 znaky na bunku, pod svetom su statistiky
+void client_view_size(int *view_w, int *view_h) {
+    *view_w = (COLS - 1) / 4;
+    *view_h = LINES - 13;
+    if (*view_w < 1) *view_w = 1;
+    if (*view_h < 1) *view_h = 1;
+    if (*view_w > VIEW_MAX) *view_w = VIEW_MAX;
+    if (*view_h > VIEW_MAX) *view_h = VIEW_MAX;
+}
+
+void draw_world(const StatsMessage *s) {
     int start_y = 6;
     int start_x = 0;
+    int width = s->view_w;
+    int height = s->view_h;
     
     // Vykresli horný okraj
-    char line_buffer[200] = {0};
+    char line_buffer[4 * VIEW_MAX + 2] = {0};
     strcpy(line_buffer, "+");
     for (int x = 0; x < width; x++) {
         strcat(line_buffer, "---+");
@@ -196,19 +241,22 @@ void draw_world(int height, int width, int posX, int posY, _Bool obstacle[50][50
     mvprintw(start_y - 1, start_x, "%-80s", line_buffer);
     
     // Vykresli grid
-    for (int world_y = height - 1; world_y >= 0; world_y--) {
-        int screen_y = start_y + (height - 1 - world_y);
+    for (int view_y = height - 1; view_y >= 0; view_y--) {
+        int screen_y = start_y + (height - 1 - view_y);
+        int world_y = s->view_y + view_y;
         
         memset(line_buffer, 0, sizeof(line_buffer));
         strcpy(line_buffer, "|");
         
-        for (int world_x = 0; world_x < width; world_x++) {
+        for (int view_x = 0; view_x < width; view_x++) {
+            int world_x = s->view_x + view_x;
+            unsigned char cell = s->view[view_y][view_x];
             // Urči obsah bunky
-            if (posX == world_x && posY == world_y) {
+            if (s->posX == world_x && s->posY == world_y) {
                 strcat(line_buffer, " @ ");
-            } else if (obstacle[world_y][world_x]) {
+            } else if (cell & CELL_OBSTACLE) {
                 strcat(line_buffer, " # ");
-            } else if (visited[world_y][world_x]) {
+            } else if (cell & CELL_VISITED) {
                 strcat(line_buffer, " . ");
             } else if (world_x == 0 && world_y == 0) {
                 strcat(line_buffer, " O ");
@@ -229,27 +277,98 @@ void draw_world(int height, int width, int posX, int posY, _Bool obstacle[50][50
     }
     mvprintw(last_y, start_x, "%-80s", line_buffer);
 }
-void draw_summary(double grid[11][11], int w, int h) {
-    clear();
-    mvprintw(1, 4, "Sumarny mod");
+// mapa zo vsetkych startov, ktoru si klient vyziada v kazdej sprave
+static DisplayType display_type = DISPLAY_AVERAGE_STEPS;
+
+DisplayType client_display_type(void) {
+    return display_type;
+}
+
+void client_toggle_display(void) {
+    display_type = display_type == DISPLAY_AVERAGE_STEPS ? DISPLAY_PROBABILITY : DISPLAY_AVERAGE_STEPS;
+}
 
-    for (int y = h-1; y >= 0; y--) {
-        for (int x = 0; x < w; x++) {
-            mvprintw(3 + (h-1-y), 4 + x*6, "%5.2f", grid[x][y]);
+// hodnota na 3 znaky: percenta uspechu, alebo kroky s k/M/G (1k2, 35k, 0M4)
+static void format_heat(char out[4], float value, int display) {
+    if (display == DISPLAY_PROBABILITY) {
+        snprintf(out, 4, "%3d", (int)(value * 100.0f + 0.5f));
+        return;
+    }
+    if (value < 999.5f) {
+        snprintf(out, 4, "%3d", (int)(value + 0.5f));
+        return;
+    }
+    const char units[] = "kMG";
+    int u = 0;
+    value /= 1000.0f;
+    while (value >= 99.5f && u < 2) {
+        value /= 1000.0f;
+        u++;
+    }
+    // zaokruhlit pred volbou tvaru, inak 999.5 da "0k9"
+    int tenths = (int)(value * 10.0f + 0.5f);
+    if (tenths < 100) {
+        out[0] = (char)('0' + tenths / 10);
+        out[1] = units[u];
+        out[2] = (char)('0' + tenths % 10);
+        out[3] = '\0';
+    } else {
+        snprintf(out, 4, "%2d%c", value < 99.5f ? (int)(value + 0.5f) : 99, units[u]);
+    }
+}
+
+void draw_heatmap(const StatsMessage *s, int start_y) {
+    int width = s->view_w;
+    int height = s->view_h;
+    if (height > LINES - start_y - 3) height = LINES - start_y - 3;
+    if (height < 1 || s->sweep_total <= 0) return;
+
+    mvprintw(start_y, 0, "[--- MAPA: %s | hotove %lld / %lld ---]          ",
+             s->display == DISPLAY_PROBABILITY ? "uspesnost %" : "priemer krokov",
+             (long long)s->sweep_done, (long long)s->sweep_total);
+
+    char line_buffer[4 * VIEW_MAX + 2] = {0};
+    strcpy(line_buffer, "+");
+    for (int x = 0; x < width; x++) {
+        strcat(line_buffer, "---+");
+    }
+    mvprintw(start_y + 1, 0, "%-80s", line_buffer);
+    mvprintw(start_y + 2 + height, 0, "%-80s", line_buffer);
+
+    // horne riadky vyrezu, rovnako ako draw_world
+    for (int row = 0; row < height; row++) {
+        int view_y = s->view_h - 1 - row;
+        int world_y = s->view_y + view_y;
+        strcpy(line_buffer, "|");
+        for (int view_x = 0; view_x < width; view_x++) {
+            int world_x = s->view_x + view_x;
+            unsigned char cell = s->view[view_y][view_x];
+            char value[4];
+            if (cell & CELL_OBSTACLE) {
+                strcpy(value, " # ");
+            } else if (world_x == 0 && world_y == 0) {
+                strcpy(value, " O ");
+            } else if (cell & CELL_HEAT) {
+                format_heat(value, s->heat[view_y][view_x], s->display);
+            } else {
+                strcpy(value, "   ");
+            }
+            strcat(line_buffer, value);
+            strcat(line_buffer, "|");
         }
+        mvprintw(start_y + 2 + row, 0, "%-80s", line_buffer);
     }
-    refresh();
 }
 void draw_stats(StatsMessage *s , int offset_y , UIState state) {
    
     mvprintw(8 + offset_y, 2, "=== STATISTIKY ===");
     
     if (state == UI_SUMMARY) {
-        int total_configured = s->total_runs + s->remaining_runs;
-        mvprintw(9 + offset_y, 4, "Total runs: %d / %d", s->total_runs, total_configured);
-        mvprintw(10 + offset_y, 4, "Successful runs: %d", s->succ_runs);
+        long long total_configured = s->total_runs + s->remaining_runs;
+        mvprintw(9 + offset_y, 4, "Total runs: %lld / %lld", (long long)s->total_runs, total_configured);
+        mvprintw(10 + offset_y, 4, "Successful runs: %lld", (long long)s->succ_runs);
         mvprintw(11 + offset_y, 4, "Success rate: %.2f %%", s->success_rate_permille / 10.0f);
-        mvprintw(12 + offset_y, 4, "Total steps: %d", s->total_steps);
+        mvprintw(12 + offset_y, 4, "Total steps: %lld", (long long)s->total_steps);
         
         if (s->total_runs > 0) {
             double avg_steps = (double)s->total_steps / s->total_runs;
@@ -261,16 +380,9 @@ void draw_stats(StatsMessage *s , int offset_y , UIState state) {
         }
         
     } else if (state == UI_INTERACTIVE) {
-        int visited = 0;
-        for (int y = 0; y < s->height; y++) {
-            for (int x = 0; x < s->width; x++) {
-                if (s->visited[y][x]) visited++;
-            }
-        }
-        
         mvprintw(9 + offset_y, 4, "Steps made: %d / %d", s->curr_steps, s->max_steps);
         mvprintw(10 + offset_y, 4, "Position: (%d, %d)", s->posX, s->posY);
-        mvprintw(11 + offset_y, 4, "Visited cells: %d / %d", visited, s->width * s->height);
+        mvprintw(11 + offset_y, 4, "Visited cells: %lld / %lld", (long long)s->visited_count, (long long)s->width * s->height);
     }
     
     if (s->finished) {
@@ -1,10 +1,14 @@
 #pragma once
 #include "../common/common.h"
+#include "../common/types.h"
 
 int draw_connection_menu(char* room_code);
 int draw_server_list_menu(char *selected_socket_path);
 UIState draw_mode_menu(int *mode);
-UIState draw_setup(int *x, int *y, int *K, int *runs, int *width, int *height, int probs[4], int mode, char *out_filename, int out_filename_len, double *obstacle_ratio);
-void draw_world(int height, int width, int posX, int posY, _Bool obstacle[50][50], _Bool visited[50][50]); 
-void draw_summary(double grid[11][11], int w, int h);
+UIState draw_setup(int *x, int *y, int *K, int *runs, int *width, int *height, double probs[4], int mode, char *out_filename, int out_filename_len, char *world_filename, int world_filename_len, double *obstacle_ratio, double adaptive[3], double *checkpoint_interval, int *exact);
+void client_view_size(int *view_w, int *view_h);
+void draw_world(const StatsMessage *s);
+DisplayType client_display_type(void);
+void client_toggle_display(void);
+void draw_heatmap(const StatsMessage *s, int start_y);
 void draw_stats(StatsMessage *s , int offset_y , UIState state); 
@@ -2,7 +2,15 @@
 
 #define SOCKET_PATH "/tmp/random_walk.sock"
 
+// Klient dostava len vyrez sveta okolo chodca, svet moze byt lubovolne velky
+#define VIEW_MAX 64
+#define CELL_OBSTACLE 1
+#define CELL_VISITED 2
+// policko mapy zo vsetkych startov uz ma hodnotu v heat
+#define CELL_HEAT 4
+
 #include <pthread.h>
+#include <stdint.h>
 
 typedef enum { 
   MSG_SIM_RUN = 1,
@@ -10,7 +18,9 @@ typedef enum {
   MSG_SIM_GET_STATS =3,
   MSG_SIM_INIT,
   MSG_SIM_STEP,
-  MSG_SIM_CONFIG
+  MSG_SIM_CONFIG,
+  // replikacie zo vsetkych volnych policok, mapa sa posiela vo vyreze
+  MSG_SIM_SWEEP
 }MessageType;
 
 typedef struct {
@@ -21,21 +31,42 @@ typedef struct {
   int height;
   int max_steps;
   int replications;
-  int probs[4];
+  double probs[4];
   double obstacle_ratio;
   char out_filename[128];
+  // ak subor existuje, svet sa z neho nacita, inak sa vygeneruje a ulozi don
+  char world_filename[128];
+  uint64_t seed;
+  int rng;
+  int view_w;
+  int view_h;
+  // DisplayType mapy vo vyreze
+  int display;
+  // adaptivny pocet replikacii (SimulationConfig), 0 = vypnute
+  double ci_rate;
+  double ci_steps;
+  double time_limit;
+  // sekundy medzi checkpointmi davky, 0 = vypnute
+  double checkpoint_interval;
+  // 1 = presne hodnoty aj na velkych svetoch (SimulationConfig.exact)
+  int exact;
 
 } Message;
 typedef struct {
-  int total_steps;
+  int64_t total_steps;
   int max_steps;
-  int succ_runs;
-  int total_runs;
+  int64_t succ_runs;
+  int64_t total_runs;
   
   int width;
   int height;
-  _Bool obstacle[50][50];
-  _Bool visited[50][50];
+
+  int view_x;
+  int view_y;
+  int view_w;
+  int view_h;
+  unsigned char view[VIEW_MAX][VIEW_MAX];
+  int64_t visited_count;
   
   int posX;
   int posY;
@@ -46,6 +77,31 @@ typedef struct {
   
   int success_rate_permille;
   int remaining_runs;
+  // dosiahnute polosirky 95 % intervalov (uspesnost 0..1, kroky)
+  double ci_rate;
+  double ci_steps;
+  // kvantily krokov uspesnych behov, -1 bez uspesneho behu
+  int64_t p50;
+  int64_t p90;
+  int64_t p99;
+  // presne hodnoty z Markovovho retazca pre start davky, exact = 0 bez nich
+  int exact;
+  double exact_hitting_time;
+  // uspesnost, priemer krokov a kvantily do K krokov, ak exact_distribution
+  int exact_distribution;
+  double exact_rate;
+  double exact_mean_steps;
+  int64_t exact_p50;
+  int64_t exact_p90;
+  int64_t exact_p99;
+  // trajektorie sa nepodarilo zapisat cele
+  int output_failed;
+
+  // mapa zo vsetkych startov vo vyreze view podla display
+  int display;
+  int64_t sweep_done;
+  int64_t sweep_total;
+  float heat[VIEW_MAX][VIEW_MAX];
 } StatsMessage;
 
 typedef enum {
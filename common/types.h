@@ -1,5 +1,7 @@
 #pragma once
 
+#include <stdint.h>
+
 typedef struct {
   int x;
   int y;
@@ -15,6 +17,12 @@ typedef enum {
   DISPLAY_PROBABILITY
 } DisplayType;
 
+typedef enum {
+  RNG_XOSHIRO256,
+  RNG_PCG32,
+  RNG_PHILOX
+} RngKind;
+
 typedef struct {
   Position pos;
   Position start_pos;
@@ -40,4 +48,20 @@ typedef struct {
   int current_replication;
   double obstacle_ratio;
   DisplayMode mode;
+  int threads;
+  uint64_t seed;
+  RngKind rng;
+  // Adaptivny pocet replikacii: behy skoncia, ked su polosirky 95 %
+  // intervalov spolahlivosti uspesnosti a priemeru krokov pod tymito
+  // hodnotami (0 = nesleduje sa), alebo po time_limit sekundach.
+  // total_replications je potom horna hranica.
+  double ci_rate;
+  double ci_steps;
+  double time_limit;
+  // davka s vystupnym suborom zapisuje checkpoint kazdych tolko sekund
+  // (0 = vypnute), pozri simulation/checkpoint.h
+  double checkpoint_interval;
+  // presne hodnoty z Markovovho retazca aj na velkych svetoch (inak len
+  // na malych), pozri simulation_analytic
+  int exact;
 } SimulationConfig;
@@ -3,6 +3,8 @@
 #include "../common/common.h"
 #include "../common/ipc.h"
 #include "../simulation/simulation.h"
+#include "../simulation/engine.h"
+#include "../simulation/checkpoint.h"
 
 #include <pthread.h>
 #include <sys/socket.h>
@@ -11,6 +13,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/time.h>
+#include <time.h>
 
 void *batch_run_thread(void *arg) {
   BatchRunArgs *a = (BatchRunArgs*)arg;
@@ -19,30 +22,107 @@ void *batch_run_thread(void *arg) {
     return NULL;
   }
   
-  for (int i = 0; i < a->count; i++) {
-    pthread_mutex_lock(a->mutex);
-    
-    if (a->state->sim) {
-      simulation_run(a->state->sim, a->start);
-    }
-    
-    pthread_mutex_unlock(a->mutex);
-    usleep(1000); 
-  }
+  // replikacie bezia paralelne, mutex sa drzi len pri zlucovani statistik
+  engine_run(a->state->sim, a->start, a->count, a->state->sim->config.threads, a->mutex);
+  // dopisanie trajektorii mimo mutexu, aby zapis na disk neblokoval klientov
+  _Bool written = simulation_close_output(a->state->sim);
+
+  // presne hodnoty na porovnanie az po behoch, pre ten isty start z cache
+  AnalyticSummary exact;
+  simulation_analytic(a->state->sim, a->start, &exact);
 
   // ulozenie vysledkov do suboru
-  if (a->state && a->state->sim && a->state->sim->filename && a->state->sim->filename[0] != '\0') {
-    pthread_mutex_lock(a->mutex);
-    if (a->state->sim) {
-      simulation_save_results(a->state->sim, a->state->sim->filename);
-    }
-    pthread_mutex_unlock(a->mutex);
+  pthread_mutex_lock(a->mutex);
+  a->state->sim->analytic = exact;
+  if (!written) a->state->sim->output_failed = 1;
+  if (a->state->sim && a->state->sim->filename && a->state->sim->filename[0] != '\0') {
+    simulation_save_results(a->state->sim, a->state->sim->filename);
   }
+  simulation_checkpoint_remove(a->state->sim);
+  a->state->batch_running = 0;
+  pthread_mutex_unlock(a->mutex);
+
+  free(a);
+  return NULL;
+}
+
+void *sweep_run_thread(void *arg) {
+  SweepRunArgs *a = (SweepRunArgs*)arg;
+  // mapa sa plni pod mutexom, klienti ju medzitym citaju po castiach
+  sweep_run(a->state->sim, a->state->sweep, a->state->sim->config.threads, a->mutex);
+
+  pthread_mutex_lock(a->mutex);
+  a->state->batch_running = 0;
+  pthread_mutex_unlock(a->mutex);
 
   free(a);
   return NULL;
 }
 
+// vyrez sveta okolo pozicie chodca, velkost si urcuje klient podla terminalu
+static void fill_view(StatsMessage *out, const World *world, Position center, int view_w, int view_h) {
+  if (view_w <= 0 || view_w > VIEW_MAX) view_w = VIEW_MAX;
+  if (view_h <= 0 || view_h > VIEW_MAX) view_h = VIEW_MAX;
+  if (view_w > world->width) view_w = world->width;
+  if (view_h > world->height) view_h = world->height;
+
+  int x0 = center.x - view_w / 2;
+  int y0 = center.y - view_h / 2;
+  if (x0 > world->width - view_w) x0 = world->width - view_w;
+  if (y0 > world->height - view_h) y0 = world->height - view_h;
+  if (x0 < 0) x0 = 0;
+  if (y0 < 0) y0 = 0;
+
+  out->view_x = x0;
+  out->view_y = y0;
+  out->view_w = view_w;
+  out->view_h = view_h;
+  out->visited_count = (int64_t)world->visited_count;
+
+  for (int y = 0; y < view_h; y++) {
+    for (int x = 0; x < view_w; x++) {
+      unsigned char cell = 0;
+      if (world_obstacle_at(world, x0 + x, y0 + y)) cell |= CELL_OBSTACLE;
+      if (world_visited_at(world, x0 + x, y0 + y)) cell |= CELL_VISITED;
+      out->view[y][x] = cell;
+    }
+  }
+}
+
+static void fill_precision(StatsMessage *out, const Simulation *sim) {
+  stat_confidence(sim->stats, &out->ci_rate, &out->ci_steps);
+  out->p50 = stat_quantile(sim->stats, 0.5);
+  out->p90 = stat_quantile(sim->stats, 0.9);
+  out->p99 = stat_quantile(sim->stats, 0.99);
+  out->exact = sim->analytic.ready;
+  out->exact_hitting_time = sim->analytic.hitting_time;
+  out->exact_distribution = sim->analytic.distribution;
+  out->exact_rate = sim->analytic.rate;
+  out->exact_mean_steps = sim->analytic.mean_steps;
+  out->exact_p50 = sim->analytic.p50;
+  out->exact_p90 = sim->analytic.p90;
+  out->exact_p99 = sim->analytic.p99;
+  out->output_failed = sim->output_failed;
+}
+
+// hodnoty mapy zo vsetkych startov v tom istom vyreze ako fill_view
+static void fill_heat(StatsMessage *out, const SweepMap *map, int display) {
+  out->display = display == DISPLAY_PROBABILITY ? DISPLAY_PROBABILITY : DISPLAY_AVERAGE_STEPS;
+  if (!map) return;
+  out->sweep_done = map->cells_done;
+  out->sweep_total = map->cells_total;
+
+  const double *values = out->display == DISPLAY_PROBABILITY ? map->probability : map->avg_steps;
+  for (int y = 0; y < out->view_h; y++) {
+    for (int x = 0; x < out->view_w; x++) {
+      size_t i = (size_t)(out->view_y + y) * (size_t)map->width + (size_t)(out->view_x + x);
+      if (!map->done[i]) continue;
+      out->view[y][x] |= CELL_HEAT;
+      out->heat[y][x] = (float)values[i];
+    }
+  }
+}
+
 void* client_thread_func(void* arg) {
   ClientThreadData *data = (ClientThreadData*)arg;
     
@@ -63,15 +143,21 @@ void handle_message(ServerState *state, int client_fd, Message *msg, pthread_mut
   if (msg->type == MSG_SIM_RUN) {
     
     if (!state->sim) return;
+
+    // prerusena davka pokracuje od posledneho checkpointu
+    if (!state->batch_running) {
+      simulation_resume(state->sim, (Position){msg->x, msg->y});
+    }
     
-    int remaining = state->sim->config.total_replications - state->sim->stats->total_runs;
+    int remaining = simulation_remaining(state->sim);
         
-    if (remaining <= 0) {
+    if (remaining <= 0 || state->batch_running) {
     } else if (remaining == 1) {
       simulation_run(state->sim, (Position){msg->x, msg->y});
       if(state->sim->stats->total_runs >= state->sim->config.total_replications) {
-        if (state->sim->filename && state->sim->filename[0] != '\0') {
-          simulation_save_results(state->sim, state->sim->filename);
+        if (state->sim->filename && state->sim->filename[0] != '\0' &&
+            !simulation_save_results(state->sim, state->sim->filename)) {
+          state->sim->output_failed = 1;
         }
         state->should_exit = 1;
       } 
@@ -84,17 +170,45 @@ void handle_message(ServerState *state, int client_fd, Message *msg, pthread_mut
       args->mutex = mutex;
       pthread_t tid;
         
+      state->batch_running = 1;
       if (pthread_create(&tid, NULL, batch_run_thread, args) == 0) {
           pthread_detach(tid);
       } else {
+        state->batch_running = 0;
         free(args);
       }
     }
 
+    } else if (msg->type == MSG_SIM_SWEEP) {
+
+    if (!state->sim || state->batch_running || state->sim->config.total_replications <= 0) return;
+
+    SweepMap *map = sweep_create(state->sim->world, state->sim->config.total_replications);
+    SweepRunArgs *args = malloc(sizeof(SweepRunArgs));
+    if (!map || !args) {
+      sweep_destroy(map);
+      free(args);
+      return;
+    }
+    sweep_destroy(state->sweep);
+    state->sweep = map;
+    args->state = state;
+    args->mutex = mutex;
+    pthread_t tid;
+
+    state->batch_running = 1;
+    if (pthread_create(&tid, NULL, sweep_run_thread, args) == 0) {
+      pthread_detach(tid);
+    } else {
+      state->batch_running = 0;
+      free(args);
+    }
+
     } else if (msg->type == MSG_SIM_STEP) {
       
-     while(!walker_move(state->sim->walker, state->sim->world));
-        
+      if (!state->sim) return;
+      walker_move(state->sim->walker, state->sim->world);
+
         
       if (state->sim->walker->at_finish) {
         state->should_exit = 1;
@@ -118,14 +232,11 @@ void handle_message(ServerState *state, int client_fd, Message *msg, pthread_mut
         out.posX = state->sim->walker->pos.x;
         out.posY = state->sim->walker->pos.y;
         out.curr_steps = state->sim->walker->steps_made;
-        out.remaining_runs = state->sim->config.total_replications - state->sim->stats->total_runs;
+        out.remaining_runs = simulation_remaining(state->sim);
             
-        for (int y = 0; y < out.height && y < 50; y++) {
-          for (int x = 0; x < out.width && x < 50; x++) {
-            out.visited[y][x] = state->sim->world->visited[y][x];
-            out.obstacle[y][x] = state->sim->world->obstacle[y][x];
-          }
-        }
+        fill_view(&out, state->sim->world, state->sim->walker->pos, msg->view_w, msg->view_h);
+        fill_heat(&out, state->sweep, msg->display);
+        fill_precision(&out, state->sim);
         if (out.total_runs > 0) {
           out.success_rate_permille = (1000 * out.succ_runs) / out.total_runs;
         } else {
@@ -137,10 +248,13 @@ void handle_message(ServerState *state, int client_fd, Message *msg, pthread_mut
       return;
 
     } else if (msg->type == MSG_SIM_INIT) {
+      if (!world_is_valid_position(state->sim->world, (Position){msg->x, msg->y})) {
+        return;
+      }
         
       state->sim->walker->pos.x = msg->x;
       state->sim->walker->pos.y = msg->y;
-      state->sim->world->visited[msg->y][msg->x] = 1;
+      world_mark_visited(state->sim->world, msg->x, msg->y);
 
       StatsMessage out = {0};
       out.width = state->sim->world->width;
@@ -149,7 +263,7 @@ void handle_message(ServerState *state, int client_fd, Message *msg, pthread_mut
       out.total_runs = state->sim->stats->total_runs;
       out.succ_runs = state->sim->stats->succ_runs;
       out.total_steps = state->sim->stats->total_steps;
-      out.remaining_runs = state->sim->config.total_replications - state->sim->stats->total_runs;
+      out.remaining_runs = simulation_remaining(state->sim);
       out.posX = state->sim->walker->pos.x;
       out.posY = state->sim->walker->pos.y;
       out.curr_steps = state->sim->walker->steps_made;
@@ -160,49 +274,109 @@ void handle_message(ServerState *state, int client_fd, Message *msg, pthread_mut
         out.success_rate_permille = 0;
       }
 
-      for (int y = 0; y < out.height && y < 50; y++) {
-        for (int x = 0; x < out.width && x < 50; x++) {
-          out.visited[y][x] = state->sim->world->visited[y][x];
-          out.obstacle[y][x] = state->sim->world->obstacle[y][x];
-        }
-      }
+      fill_view(&out, state->sim->world, state->sim->walker->pos, msg->view_w, msg->view_h);
 
       write(client_fd, &out, sizeof(out));
       return; 
     } else if (msg->type == MSG_SIM_CONFIG) {
-      if (state->sim != NULL) {
-        simulation_destroy(state->sim);
+      StatsMessage ack = {0};
+      Position start = {msg->x, msg->y};
+      int width = msg->width;
+      int height = msg->height;
+
+      // svet zo suboru urcuje rozmery, inak sa vygeneruje podla spravy
+      msg->world_filename[sizeof(msg->world_filename) - 1] = '\0';
+      World *loaded = NULL;
+      if (!state->batch_running && msg->world_filename[0] != '\0') {
+        loaded = world_load_from_file(msg->world_filename);
+        if (loaded) {
+          width = loaded->width;
+          height = loaded->height;
+        }
+      }
+
+      // pocas davky sa simulacia nesmie zrusit, neplatny start sa odmietne
+      if (state->batch_running || width <= 0 || height <= 0 ||
+          start.x < 0 || start.y < 0 || start.x >= width || start.y >= height ||
+          (loaded && !world_is_accessible(loaded, start))) {
+        world_destroy(loaded);
+        write(client_fd, &ack, sizeof(ack));
+        return;
       }
 
       SimulationConfig new_config = {
-        .width = msg->width,
-        .height = msg->height,
+        .width = width,
+        .height = height,
         .x = msg->x,
         .y = msg->y,
         .max_steps_K = msg->max_steps,
         .total_replications = msg->replications,
         .probs = (MoveProbabilities){ msg->probs[0] ,msg->probs[1] ,msg->probs[2] ,msg->probs[3] },
-        .obstacle_ratio = msg->obstacle_ratio
+        .obstacle_ratio = msg->obstacle_ratio,
+        .seed = msg->seed,
+        .rng = (msg->rng == RNG_PCG32 || msg->rng == RNG_PHILOX) ? (RngKind)msg->rng : RNG_XOSHIRO256,
+        .ci_rate = msg->ci_rate > 0 ? msg->ci_rate : 0,
+        .ci_steps = msg->ci_steps > 0 ? msg->ci_steps : 0,
+        .time_limit = msg->time_limit > 0 ? msg->time_limit : 0,
+        .checkpoint_interval = msg->checkpoint_interval > 0 ? msg->checkpoint_interval : 0,
+        .exact = msg->exact != 0
         };
 
-      state->sim = simulation_create(new_config);
+      // Bez zadaneho seedu sa prevezme seed z checkpointu tej istej
+      // konfiguracie, aby sa davka dala obnovit (aj nahodny svet sa z neho
+      // vygeneruje znova rovnako). Cudzi checkpoint seed neovplyvni.
+      msg->out_filename[sizeof(msg->out_filename) - 1] = '\0';
+      if (!new_config.seed && msg->out_filename[0] != '\0') {
+        new_config.seed = checkpoint_seed(msg->out_filename, &new_config, start);
+      }
+      if (!new_config.seed) {
+        new_config.seed = ((uint64_t)time(NULL) << 20) ^ (uint64_t)getpid();
+      }
+
+      // Novy svet a simulacia sa pripravia bokom. Ak nieco zlyha, klient
+      // dostane chybove potvrdenie a predosla simulacia ostava.
+      World *world = loaded;
+      if (!world) {
+        Rng world_rng;
+        rng_seed(&world_rng, new_config.rng, new_config.seed, RNG_STREAM_WORLD);
+        world = create_guaranteed_world(width, height, msg->obstacle_ratio, start, &world_rng);
+      }
+      Simulation *sim = world ? simulation_create_with_world(new_config, world) : NULL;
+      if (!sim) {
+        world_destroy(world);
+        write(client_fd, &ack, sizeof(ack));
+        return;
+      }
+      // novy subor sveta sa zalozi, existujuci (aj neplatny) sa neprepisuje
+      if (!loaded && msg->world_filename[0] != '\0' && access(msg->world_filename, F_OK) != 0) {
+        world_save_to_file(world, msg->world_filename);
+      }
+
+      if (state->sim != NULL) {
+        simulation_destroy(state->sim);
+      }
+      sweep_destroy(state->sweep);
+      state->sweep = NULL;
+      state->sim = sim;
 
       if (msg->out_filename[0] != '\0') {
         if (state->sim->filename) free(state->sim->filename);
         state->sim->filename = strdup(msg->out_filename);
       }
 
-      world_destroy(state->sim->world);
-      state->sim->world = create_guaranteed_world(msg->width , msg->height, msg->obstacle_ratio, (Position){msg->x, msg->y});
       state->start_x = msg->x;
       state->start_y = msg->y;
 
       state->sim->walker->pos.x = msg->x;
-      state->sim->world->visited[state->start_y][state->start_x] = 1;
+      world_mark_visited(state->sim->world, state->start_x, state->start_y);
 
-      StatsMessage ack = {0};
-      ack.width = msg->width;
-      ack.height = msg->height;
+      if (state->socket_path) {
+        unregister_server(state->socket_path);
+        register_server(state->socket_path, width, height);
+      }
+
+      ack.width = width;
+      ack.height = height;
       ack.max_steps = msg->max_steps;
       ack.remaining_runs = msg->replications;
       ack.posX = msg->x;
@@ -214,12 +388,7 @@ void handle_message(ServerState *state, int client_fd, Message *msg, pthread_mut
       ack.finished = 0;
       ack.success_rate_permille = 0;
 
-      for (int y = 0; y < ack.height && y < 50; y++) {
-        for (int x = 0; x < ack.width && x < 50; x++) {
-          ack.obstacle[y][x] = state->sim->world->obstacle[y][x];
-          ack.visited[y][x] = state->sim->world->visited[y][x];
-        }
-      }
+      fill_view(&ack, state->sim->world, state->sim->walker->pos, msg->view_w, msg->view_h);
 
       write(client_fd, &ack, sizeof(ack));
       return;
@@ -239,7 +408,7 @@ void handle_message(ServerState *state, int client_fd, Message *msg, pthread_mut
   out.posX        = state->sim->walker->pos.x;
   out.posY        = state->sim->walker->pos.y;
   out.finished    = state->should_exit;
-  out.remaining_runs = state->sim->config.total_replications - state->sim->stats->total_runs;
+  out.remaining_runs = simulation_remaining(state->sim);
     
   
   if (out.total_runs > 0) {
@@ -249,12 +418,9 @@ void handle_message(ServerState *state, int client_fd, Message *msg, pthread_mut
   }
 
     
-  for (int y = 0; y < out.height && y < 50; y++) {
-    for (int x = 0; x < out.width && x < 50; x++) {
-      out.visited[y][x]  = state->sim->world->visited[y][x];
-      out.obstacle[y][x] = state->sim->world->obstacle[y][x];
-    }
-  }
+  fill_view(&out, state->sim->world, state->sim->walker->pos, msg->view_w, msg->view_h);
+  fill_heat(&out, state->sweep, msg->display);
+  fill_precision(&out, state->sim);
 
   write(client_fd, &out, sizeof(out));
 }
@@ -264,6 +430,7 @@ void server_run(const char * socket_path) {
   
   ServerState state = {0};
   state.should_exit = 0;
+  state.socket_path = socket_path;
   pthread_mutex_t sim_mutex = PTHREAD_MUTEX_INITIALIZER;
     
   int server_fd = socket(AF_UNIX, SOCK_STREAM, 0);
@@ -283,8 +450,8 @@ void server_run(const char * socket_path) {
     return;
   }
 
-  // Zapisanie serveru
-  register_server(socket_path, 50, 50);
+  // Zapisanie serveru, rozmery sveta sa doplnia po konfiguracii
+  register_server(socket_path, 0, 0);
 
     
   struct timeval tv;
@@ -316,6 +483,7 @@ void server_run(const char * socket_path) {
     unregister_server(socket_path);
 
     if(state.sim) simulation_destroy(state.sim);
+    sweep_destroy(state.sweep);
     pthread_mutex_destroy(&sim_mutex);
 }
 
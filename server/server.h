@@ -16,6 +16,11 @@ typedef struct {
     pthread_mutex_t *mutex;
 } BatchRunArgs;
 
+typedef struct {
+    ServerState *state;
+    pthread_mutex_t *mutex;
+} SweepRunArgs;
+
 void server_run(const char * socket_path);
 void handle_message(ServerState * state , int client_fd , Message * msg, pthread_mutex_t *mutex);
 
@@ -2,11 +2,16 @@
 #pragma once
 
 #include "../simulation/simulation.h"
+#include "../simulation/sweep.h"
 
 typedef struct {
   Simulation *sim;
   int start_x;
   int start_y;
   int should_exit;
+  int batch_running;
+  // posledna mapa zo vsetkych startov, plni sa pocas behu sweep vlakna
+  SweepMap *sweep;
+  const char *socket_path;
 } ServerState;
 
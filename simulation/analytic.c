@@ -0,0 +1,768 @@
+#include "analytic.h"
+#include "batch.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CELL_REACH 1  // z policka sa da s kladnou pravdepodobnostou dojst do ciela
+#define CELL_LOST  2  // z policka sa s kladnou pravdepodobnostou do ciela nedojde
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define ANALYTIC_X86 1
+#endif
+
+// dlazdice pre sirenie rozdelenia: jadro ANALYTIC_TILE^2 policok s okrajom
+// na ANALYTIC_TILE_STEPS krokov; mensie mriezky sa krokuju cele
+#define ANALYTIC_TILE       128
+#define ANALYTIC_TILE_STEPS 8
+#define ANALYTIC_TILE_MIN_CELLS (1 << 16)
+
+// pravdepodobnost smeru pre kazdu masku presne podla prahov v tabulke
+static void mask_probs(const MoveTable *moves, double p[16][4]) {
+  memset(p, 0, 16 * sizeof(p[0]));
+  for (unsigned m = 0; m < 16; m++) {
+    if (move_table_stuck(moves, m)) continue;
+    uint64_t lo = 0;
+    for (int j = 0; j < 4; j++) {
+      uint64_t hi = j < 3 ? moves->threshold[m][j] : ((uint64_t)1 << 32);
+      if (hi > lo) {
+        p[m][moves->dir[m][j]] += (double)(hi - lo) / 4294967296.0;
+        lo = hi;
+      }
+    }
+  }
+}
+
+// Spatne BFS: oznaci flag kazde volne policko okrem ciela, z ktoreho vedie
+// prechod s kladnou pravdepodobnostou do uz oznaceneho policka.
+static void mark_back(const World *world, const MoveTable *moves, double p[16][4],
+                      uint8_t *flags, uint8_t flag, size_t *queue, size_t tail) {
+  size_t head = 0;
+  while (head < tail) {
+    size_t n = queue[head++];
+    Position pos = { (int)(n % (size_t)world->width), (int)(n / (size_t)world->width) };
+    for (int d = 0; d < 4; d++) {
+      Position c = move_apply(world->width, world->height, pos, d);
+      size_t idx = world_cell_index(world, c.x, c.y);
+      if ((flags[idx] & flag) || idx == 0 || world_obstacle_at(world, c.x, c.y)) continue;
+      // z c do n vedie opacny smer (DOWN<->UP, LEFT<->RIGHT)
+      if (p[moves->mask[idx]][d ^ 1] > 0) {
+        flags[idx] |= flag;
+        queue[tail++] = idx;
+      }
+    }
+  }
+}
+
+// Cas je konecny presne tam, kde sa da dojst do ciela a neda sa dojst do
+// policka, z ktoreho ciel nie je dosiahnutelny.
+static uint8_t *finite_cells(const World *world, const MoveTable *moves, double p[16][4]) {
+  size_t cells = (size_t)world->width * (size_t)world->height;
+  uint8_t *flags = calloc(cells, 1);
+  size_t *queue = malloc(cells * sizeof(size_t));
+  if (!flags || !queue) {
+    free(flags);
+    free(queue);
+    return NULL;
+  }
+
+  size_t tail = 0;
+  if (!world_obstacle_at(world, 0, 0)) {
+    flags[0] = CELL_REACH;
+    queue[tail++] = 0;
+  }
+  mark_back(world, moves, p, flags, CELL_REACH, queue, tail);
+
+  tail = 0;
+  for (int y = 0; y < world->height; y++) {
+    for (int x = 0; x < world->width; x++) {
+      size_t idx = world_cell_index(world, x, y);
+      if (!(flags[idx] & CELL_REACH) && !world_obstacle_at(world, x, y)) {
+        flags[idx] |= CELL_LOST;
+        queue[tail++] = idx;
+      }
+    }
+  }
+  mark_back(world, moves, p, flags, CELL_LOST, queue, tail);
+
+  free(queue);
+  return flags;
+}
+
+// Uroven multigridu: 5-bodova matica na torusovej mriezke width x height.
+// Riadok I: diag[I] x[I] + sum_d off[I][d] x[sused v smere d] = b[I].
+// Neaktivne policka (prekazky, ciel, nekonecny cas) maju diag 0 a x 0.
+typedef struct {
+  int width;
+  int height;
+  double *diag;
+  double (*off)[4];
+  double *x;
+  double *b;
+  double *r;
+} MgLevel;
+
+static _Bool level_alloc(MgLevel *l, int width, int height) {
+  size_t n = (size_t)width * (size_t)height;
+  l->width = width;
+  l->height = height;
+  l->diag = calloc(n, sizeof(double));
+  l->off = calloc(n, sizeof(l->off[0]));
+  l->x = calloc(n, sizeof(double));
+  l->b = calloc(n, sizeof(double));
+  l->r = calloc(n, sizeof(double));
+  return l->diag && l->off && l->x && l->b && l->r;
+}
+
+static void level_free(MgLevel *l) {
+  free(l->diag);
+  free(l->off);
+  free(l->x);
+  free(l->b);
+  free(l->r);
+}
+
+static inline size_t level_nb(const MgLevel *l, int x, int y, int d) {
+  Position n = move_apply(l->width, l->height, (Position){x, y}, d);
+  return (size_t)n.y * (size_t)l->width + (size_t)n.x;
+}
+
+// indexy styroch susedov v poradi MOVE_DOWN, MOVE_UP, MOVE_LEFT, MOVE_RIGHT
+#define LEVEL_NEIGHBOURS(l, x, y, n) \
+  size_t n[4]; \
+  do { \
+    size_t w_ = (size_t)(l)->width; \
+    size_t row_ = (size_t)(y) * w_; \
+    n[MOVE_DOWN] = ((y) + 1 == (l)->height ? 0 : row_ + w_) + (size_t)(x); \
+    n[MOVE_UP] = ((y) == 0 ? (size_t)((l)->height - 1) * w_ : row_ - w_) + (size_t)(x); \
+    n[MOVE_LEFT] = row_ + ((x) == 0 ? w_ - 1 : (size_t)(x) - 1); \
+    n[MOVE_RIGHT] = row_ + ((size_t)(x) + 1 == w_ ? 0 : (size_t)(x) + 1); \
+  } while (0)
+
+// T(c) = 1 + sum p(c->n) T(n), T(ciel) = 0; ciel a nekonecne policka su
+// neaktivne, takze ich cleny vypadnu. Krok na to iste policko (sirka alebo
+// vyska 1) sa prevedie do diagonaly.
+static void level_fine(MgLevel *l, const MoveTable *moves, double p[16][4], const uint8_t *flags) {
+  for (int y = 0; y < l->height; y++) {
+    for (int x = 0; x < l->width; x++) {
+      size_t i = (size_t)y * (size_t)l->width + (size_t)x;
+      if (flags[i] != CELL_REACH || i == 0) continue;
+      const double *q = p[moves->mask[i]];
+      l->diag[i] = 1.0;
+      l->b[i] = 1.0;
+      for (int d = 0; d < 4; d++) {
+        if (q[d] == 0) continue;
+        size_t n = level_nb(l, x, y, d);
+        if (n == i) l->diag[i] -= q[d];
+        else if (flags[n] == CELL_REACH && n != 0) l->off[i][d] = -q[d];
+      }
+    }
+  }
+}
+
+// Galerkinova hrubsia matica pre agregaty 2x2 (po stlpcoch/riadkoch na
+// okraji aj 1): prechody vnutri agregatu idu do diagonaly, prechod cez
+// hranicu v smere d vedie vzdy do susedneho agregatu v tom istom smere.
+static void level_coarsen(const MgLevel *f, MgLevel *c) {
+  for (int y = 0; y < f->height; y++) {
+    for (int x = 0; x < f->width; x++) {
+      size_t i = (size_t)y * (size_t)f->width + (size_t)x;
+      if (f->diag[i] == 0) continue;
+      size_t I = (size_t)(y / 2) * (size_t)c->width + (size_t)(x / 2);
+      c->diag[I] += f->diag[i];
+      for (int d = 0; d < 4; d++) {
+        if (f->off[i][d] == 0) continue;
+        size_t n = level_nb(f, x, y, d);
+        size_t J = (size_t)(n / (size_t)f->width / 2) * (size_t)c->width + (size_t)(n % (size_t)f->width / 2);
+        if (J == I) c->diag[I] += f->off[i][d];
+        else c->off[I][d] += f->off[i][d];
+      }
+    }
+  }
+}
+
+// Gauss-Seidel; vrati najvacsiu zmenu
+static double level_sweep(MgLevel *l) {
+  double change = 0;
+  for (int y = 0; y < l->height; y++) {
+    for (int x = 0; x < l->width; x++) {
+      size_t i = (size_t)y * (size_t)l->width + (size_t)x;
+      if (l->diag[i] <= 0) continue;
+      LEVEL_NEIGHBOURS(l, x, y, n);
+      const double *o = l->off[i];
+      double sum = l->b[i] - o[0] * l->x[n[0]] - o[1] * l->x[n[1]] - o[2] * l->x[n[2]] - o[3] * l->x[n[3]];
+      double next = sum / l->diag[i];
+      double delta = fabs(next - l->x[i]);
+      if (!(delta <= change)) change = delta;
+      l->x[i] = next;
+    }
+  }
+  return change;
+}
+
+// Gauss-Seidel v opacnom poradi (po doprednom dava symetricky vyhladzovac)
+static void level_sweep_back(MgLevel *l) {
+  for (int y = l->height - 1; y >= 0; y--) {
+    for (int x = l->width - 1; x >= 0; x--) {
+      size_t i = (size_t)y * (size_t)l->width + (size_t)x;
+      if (l->diag[i] <= 0) continue;
+      LEVEL_NEIGHBOURS(l, x, y, n);
+      const double *o = l->off[i];
+      l->x[i] = (l->b[i] - o[0] * l->x[n[0]] - o[1] * l->x[n[1]] - o[2] * l->x[n[2]] - o[3] * l->x[n[3]]) /
+                l->diag[i];
+    }
+  }
+}
+
+static void level_residual(MgLevel *l) {
+  for (int y = 0; y < l->height; y++) {
+    for (int x = 0; x < l->width; x++) {
+      size_t i = (size_t)y * (size_t)l->width + (size_t)x;
+      if (l->diag[i] <= 0) continue;
+      LEVEL_NEIGHBOURS(l, x, y, n);
+      const double *o = l->off[i];
+      l->r[i] = l->b[i] - l->diag[i] * l->x[i] - o[0] * l->x[n[0]] - o[1] * l->x[n[1]] -
+                o[2] * l->x[n[2]] - o[3] * l->x[n[3]];
+    }
+  }
+}
+
+// W-cyklus: hrubsia uroven sa riesi dvakrat, lebo prolongacia po
+// agregatoch (po castiach konstantna) sama opravi hrube chyby len ciastocne.
+static void mg_cycle(MgLevel *levels, int k, int count) {
+  MgLevel *f = &levels[k];
+  if (k == count - 1) {
+    for (int s = 0; s < 50 && level_sweep(f) > 0; s++) {}
+    return;
+  }
+
+  level_sweep(f);
+  level_sweep(f);
+  level_residual(f);
+
+  MgLevel *c = &levels[k + 1];
+  size_t cn = (size_t)c->width * (size_t)c->height;
+  memset(c->b, 0, cn * sizeof(double));
+  memset(c->x, 0, cn * sizeof(double));
+  for (int y = 0; y < f->height; y++) {
+    for (int x = 0; x < f->width; x++) {
+      size_t i = (size_t)y * (size_t)f->width + (size_t)x;
+      if (f->diag[i] > 0) c->b[(size_t)(y / 2) * (size_t)c->width + (size_t)(x / 2)] += f->r[i];
+    }
+  }
+
+  mg_cycle(levels, k + 1, count);
+  if (k + 2 < count) mg_cycle(levels, k + 1, count);
+
+  for (int y = 0; y < f->height; y++) {
+    for (int x = 0; x < f->width; x++) {
+      size_t i = (size_t)y * (size_t)f->width + (size_t)x;
+      if (f->diag[i] > 0) f->x[i] += c->x[(size_t)(y / 2) * (size_t)c->width + (size_t)(x / 2)];
+    }
+  }
+
+  level_sweep_back(f);
+  level_sweep_back(f);
+}
+
+static void level_apply(const MgLevel *l, const double *x, double *y) {
+  for (int yy = 0; yy < l->height; yy++) {
+    for (int xx = 0; xx < l->width; xx++) {
+      size_t i = (size_t)yy * (size_t)l->width + (size_t)xx;
+      if (l->diag[i] <= 0) {
+        y[i] = 0;
+        continue;
+      }
+      LEVEL_NEIGHBOURS(l, xx, yy, n);
+      const double *o = l->off[i];
+      y[i] = l->diag[i] * x[i] + o[0] * x[n[0]] + o[1] * x[n[1]] + o[2] * x[n[2]] + o[3] * x[n[3]];
+    }
+  }
+}
+
+// predpodmienenie: jeden cyklus z nuly pre pravu stranu in
+static void precondition(MgLevel *levels, int count, const double *in, double *out, size_t n) {
+  memcpy(levels[0].b, in, n * sizeof(double));
+  memset(levels[0].x, 0, n * sizeof(double));
+  mg_cycle(levels, 0, count);
+  memcpy(out, levels[0].x, n * sizeof(double));
+}
+
+static double dot(const double *a, const double *b, size_t n) {
+  double sum = 0;
+  for (size_t i = 0; i < n; i++) sum += a[i] * b[i];
+  return sum;
+}
+
+// BiCGStab s multigridovym cyklom ako predpodmienenim (matica je pri nerovnomernych
+// pravdepodobnostiach nesymetricka); vrati pocet iteracii, do *residual
+// relativnu normu rezidua
+static int solve(MgLevel *levels, int count, double *x, double tolerance, int max_iterations,
+                 double *residual) {
+  MgLevel *f = &levels[0];
+  size_t n = (size_t)f->width * (size_t)f->height;
+  double *buf = calloc(6 * n, sizeof(double));
+  if (!buf) return -1;
+  double *r = buf, *rhat = buf + n, *p = buf + 2 * n, *v = buf + 3 * n, *y = buf + 4 * n, *t = buf + 5 * n;
+
+  memset(x, 0, n * sizeof(double));
+  for (size_t i = 0; i < n; i++) {
+    r[i] = f->diag[i] > 0 ? 1.0 : 0.0;
+    rhat[i] = r[i];
+  }
+  double bnorm = sqrt(dot(r, r, n));
+  double rho = 1, alpha = 1, omega = 1;
+  int it = 0;
+  *residual = bnorm > 0 ? 1.0 : 0.0;
+
+  while (it < max_iterations && *residual >= tolerance) {
+    it++;
+    double rho1 = dot(rhat, r, n);
+    if (rho1 == 0) break;
+    double beta = (rho1 / rho) * (alpha / omega);
+    for (size_t i = 0; i < n; i++) p[i] = r[i] + beta * (p[i] - omega * v[i]);
+
+    precondition(levels, count, p, y, n);
+    level_apply(f, y, v);
+    alpha = rho1 / dot(rhat, v, n);
+    for (size_t i = 0; i < n; i++) {
+      x[i] += alpha * y[i];
+      r[i] -= alpha * v[i];
+    }
+    *residual = sqrt(dot(r, r, n)) / bnorm;
+    if (*residual < tolerance) break;
+
+    precondition(levels, count, r, y, n);
+    level_apply(f, y, t);
+    double tt = dot(t, t, n);
+    omega = tt > 0 ? dot(t, r, n) / tt : 0;
+    for (size_t i = 0; i < n; i++) {
+      x[i] += omega * y[i];
+      r[i] -= omega * t[i];
+    }
+    *residual = sqrt(dot(r, r, n)) / bnorm;
+    rho = rho1;
+    if (omega == 0) break;
+  }
+
+  free(buf);
+  return it;
+}
+
+HittingTimes *analytic_hitting_times(const World *world, const MoveTable *moves,
+                                     double tolerance, int max_iterations) {
+  int width = world->width;
+  int height = world->height;
+  size_t cells = (size_t)width * (size_t)height;
+
+  HittingTimes *ht = malloc(sizeof(HittingTimes));
+  if (!ht) return NULL;
+  ht->width = width;
+  ht->height = height;
+  ht->iterations = 0;
+  ht->residual = 0;
+  ht->steps = malloc(cells * sizeof(double));
+
+  double p[16][4];
+  mask_probs(moves, p);
+  uint8_t *flags = ht->steps ? finite_cells(world, moves, p) : NULL;
+  if (!flags) {
+    analytic_hitting_times_destroy(ht);
+    return NULL;
+  }
+
+  // hierarchia az po jedno policko, kazda uroven ma stvrtinu policok
+  MgLevel levels[64];
+  int count = 0;
+  _Bool ok = level_alloc(&levels[count++], width, height);
+  if (ok) level_fine(&levels[0], moves, p, flags);
+  while (ok && (levels[count - 1].width > 1 || levels[count - 1].height > 1)) {
+    MgLevel *f = &levels[count - 1];
+    ok = level_alloc(&levels[count++], (f->width + 1) / 2, (f->height + 1) / 2);
+    if (ok) level_coarsen(f, &levels[count - 1]);
+  }
+
+  if (ok) {
+    ht->iterations = solve(levels, count, ht->steps, tolerance, max_iterations, &ht->residual);
+    ok = ht->iterations >= 0;
+  }
+  if (ok) {
+    for (size_t i = 0; i < cells; i++) {
+      if (flags[i] != CELL_REACH) ht->steps[i] = INFINITY;
+    }
+  }
+
+  for (int k = 0; k < count; k++) level_free(&levels[k]);
+  free(flags);
+  if (!ok) {
+    analytic_hitting_times_destroy(ht);
+    return NULL;
+  }
+  return ht;
+}
+
+void analytic_hitting_times_destroy(HittingTimes *ht) {
+  if (!ht) return;
+  free(ht->steps);
+  free(ht);
+}
+
+// Stencil v tvare "odkial pride hmota": next[i] = c[i] cur[i] + n[i] cur[i - w]
+// + s[i] cur[i + w] + w[i] cur[i - 1] + e[i] cur[i + 1].
+typedef struct {
+  double *c;
+  double *n;
+  double *s;
+  double *w;
+  double *e;
+} Stencil;
+
+static _Bool stencil_alloc(Stencil *st, size_t cells) {
+  st->c = calloc(5 * cells, sizeof(double));
+  if (!st->c) return 0;
+  st->n = st->c + cells;
+  st->s = st->c + 2 * cells;
+  st->w = st->c + 3 * cells;
+  st->e = st->c + 4 * cells;
+  return 1;
+}
+
+// Kazde volne policko okrem ciela posle hmotu do susedov podla masky;
+// zaseknute policko a ciel si ju nechaju. Krok na to iste policko (sirka
+// alebo vyska 1) ide do c.
+static void stencil_build(Stencil *st, const World *world, const MoveTable *moves, double p[16][4]) {
+  for (int y = 0; y < world->height; y++) {
+    for (int x = 0; x < world->width; x++) {
+      if (world_obstacle_at(world, x, y)) continue;
+      size_t i = world_cell_index(world, x, y);
+      unsigned m = moves->mask[i];
+      if (i == 0 || move_table_stuck(moves, m)) {
+        st->c[i] += 1.0;
+        continue;
+      }
+      for (int d = 0; d < 4; d++) {
+        if (p[m][d] == 0) continue;
+        Position t = move_apply(world->width, world->height, (Position){x, y}, d);
+        size_t j = world_cell_index(world, t.x, t.y);
+        if (j == i) st->c[j] += p[m][d];
+        else if (d == MOVE_DOWN) st->n[j] = p[m][d];
+        else if (d == MOVE_UP) st->s[j] = p[m][d];
+        else if (d == MOVE_LEFT) st->e[j] = p[m][d];
+        else st->w[j] = p[m][d];
+      }
+    }
+  }
+}
+
+// volne policka okrem ciela, na ktorych sa walker zasekne (beh tam konci)
+static size_t *stuck_cells(const World *world, const MoveTable *moves, size_t *count) {
+  size_t cells = (size_t)world->width * (size_t)world->height;
+  *count = 0;
+  if (moves->stuck == 0) return malloc(1);
+  size_t *list = malloc(cells * sizeof(size_t));
+  if (!list) return NULL;
+  for (size_t i = 1; i < cells; i++) {
+    Position pos = { (int)(i % (size_t)world->width), (int)(i / (size_t)world->width) };
+    if (!world_obstacle_at(world, pos.x, pos.y) && move_table_stuck(moves, moves->mask[i])) list[(*count)++] = i;
+  }
+  return list;
+}
+
+static double stuck_mass(const double *cur, const size_t *stuck, size_t count) {
+  double sum = 0;
+  for (size_t j = 0; j < count; j++) sum += cur[stuck[j]];
+  return sum;
+}
+
+// jeden riadok stencilu pre stlpce [from, to); cur[x - 1] a cur[x + 1] musia existovat
+static void row_step(double *out, const double *cur, const double *up, const double *dn,
+                     const Stencil *st, size_t off, int from, int to) {
+  const double *c = st->c + off, *n = st->n + off, *s = st->s + off, *w = st->w + off, *e = st->e + off;
+  for (int x = from; x < to; x++) {
+    out[x] = c[x] * cur[x] + n[x] * up[x] + s[x] * dn[x] + w[x] * cur[x - 1] + e[x] * cur[x + 1];
+  }
+}
+
+#ifdef ANALYTIC_X86
+// rovnake poradie operacii ako row_step (bez FMA), vysledky su zhodne
+__attribute__((target("avx2")))
+static void row_step_avx2(double *out, const double *cur, const double *up, const double *dn,
+                          const Stencil *st, size_t off, int from, int to) {
+  const double *c = st->c + off, *n = st->n + off, *s = st->s + off, *w = st->w + off, *e = st->e + off;
+  int x = from;
+  for (; x + 4 <= to; x += 4) {
+    __m256d v = _mm256_mul_pd(_mm256_loadu_pd(c + x), _mm256_loadu_pd(cur + x));
+    v = _mm256_add_pd(v, _mm256_mul_pd(_mm256_loadu_pd(n + x), _mm256_loadu_pd(up + x)));
+    v = _mm256_add_pd(v, _mm256_mul_pd(_mm256_loadu_pd(s + x), _mm256_loadu_pd(dn + x)));
+    v = _mm256_add_pd(v, _mm256_mul_pd(_mm256_loadu_pd(w + x), _mm256_loadu_pd(cur + x - 1)));
+    v = _mm256_add_pd(v, _mm256_mul_pd(_mm256_loadu_pd(e + x), _mm256_loadu_pd(cur + x + 1)));
+    _mm256_storeu_pd(out + x, v);
+  }
+  // zvysok tu, nie volanim row_step: prechod z AVX do SSE kodu bez
+  // vzeroupper je na niektorych procesoroch velmi drahy
+  for (; x < to; x++) {
+    out[x] = c[x] * cur[x] + n[x] * up[x] + s[x] * dn[x] + w[x] * cur[x - 1] + e[x] * cur[x + 1];
+  }
+}
+#endif
+
+typedef void (*RowStep)(double *, const double *, const double *, const double *,
+                        const Stencil *, size_t, int, int);
+
+static inline double cell_step(const double *cur, const Stencil *st, int width, int height, int x, int y) {
+  size_t row = (size_t)y * (size_t)width;
+  size_t i = row + (size_t)x;
+  size_t up = (size_t)(y == 0 ? height - 1 : y - 1) * (size_t)width + (size_t)x;
+  size_t dn = (size_t)(y + 1 == height ? 0 : y + 1) * (size_t)width + (size_t)x;
+  size_t l = row + (size_t)(x == 0 ? width - 1 : x - 1);
+  size_t r = row + (size_t)(x + 1 == width ? 0 : x + 1);
+  return st->c[i] * cur[i] + st->n[i] * cur[up] + st->s[i] * cur[dn] + st->w[i] * cur[l] + st->e[i] * cur[r];
+}
+
+// jeden krok celej mriezky; okrajove stlpce s prechodom cez okraj zvlast
+static void grid_step(double *next, const double *cur, const Stencil *st, int width, int height, RowStep step) {
+  for (int y = 0; y < height; y++) {
+    size_t row = (size_t)y * (size_t)width;
+    const double *up = cur + (size_t)(y == 0 ? height - 1 : y - 1) * (size_t)width;
+    const double *dn = cur + (size_t)(y + 1 == height ? 0 : y + 1) * (size_t)width;
+    if (width > 2) step(next + row, cur + row, up, dn, st, row, 1, width - 1);
+    next[row] = cell_step(cur, st, width, height, 0, y);
+    if (width > 1) next[row + (size_t)width - 1] = cell_step(cur, st, width, height, width - 1, y);
+  }
+}
+
+// Dlazdice: jadro najviac ANALYTIC_TILE^2 policok s okrajom S =
+// ANALYTIC_TILE_STEPS policok, skopirovane s prechodom cez okraj torusa.
+// Po k-tom kroku je platna oblast o k policok uzsia z kazdej strany, jadro
+// teda plati aj po S krokoch. Koeficienty sa do dlazdic prepisu raz, v
+// kazdom pase krokov sa kopiruje uz len rozdelenie.
+typedef struct {
+  int width;
+  int height;
+  int cols;
+  int rows;
+  Stencil st;     // koeficienty dlazdic za sebou
+  size_t *off;    // zaciatok dlazdice v st
+  size_t *stuck;  // zaseknute policka jadier ako indexy v dlazdici, po dlazdiciach
+  size_t *stuck_from;  // cols * rows + 1 zaciatkov v stuck
+  double *a;
+  double *b;
+} Tiles;
+
+#define TILE_SPAN (ANALYTIC_TILE + 2 * ANALYTIC_TILE_STEPS)
+
+static void tile_core(const Tiles *t, int tx, int ty, int *x0, int *y0, int *bw, int *bh) {
+  *x0 = tx * ANALYTIC_TILE;
+  *y0 = ty * ANALYTIC_TILE;
+  *bw = t->width - *x0 < ANALYTIC_TILE ? t->width - *x0 : ANALYTIC_TILE;
+  *bh = t->height - *y0 < ANALYTIC_TILE ? t->height - *y0 : ANALYTIC_TILE;
+}
+
+// skopiruje okolie jadra (x0, y0) velkosti lw x lh z mriezky src;
+// mriezka je aspon TILE_SPAN siroka, riadok sa teda zalomi najviac raz
+static void tile_load(const Tiles *t, double *dst, const double *src, int x0, int y0, int lw, int lh) {
+  int gx = (x0 - ANALYTIC_TILE_STEPS + t->width) % t->width;
+  int first = t->width - gx < lw ? t->width - gx : lw;
+  for (int ly = 0; ly < lh; ly++) {
+    int gy = (y0 - ANALYTIC_TILE_STEPS + ly + t->height) % t->height;
+    const double *row = src + (size_t)gy * (size_t)t->width;
+    memcpy(dst, row + gx, (size_t)first * sizeof(double));
+    memcpy(dst + first, row, (size_t)(lw - first) * sizeof(double));
+    dst += lw;
+  }
+}
+
+static _Bool tiles_create(Tiles *t, const Stencil *st, int width, int height,
+                         const size_t *stuck, size_t stuck_count) {
+  t->width = width;
+  t->height = height;
+  t->cols = (width + ANALYTIC_TILE - 1) / ANALYTIC_TILE;
+  t->rows = (height + ANALYTIC_TILE - 1) / ANALYTIC_TILE;
+  size_t count = (size_t)t->cols * (size_t)t->rows;
+  t->off = malloc(count * sizeof(size_t));
+  t->stuck = malloc(stuck_count ? stuck_count * sizeof(size_t) : 1);
+  t->stuck_from = calloc(count + 1, sizeof(size_t));
+  t->a = malloc(2 * (size_t)TILE_SPAN * TILE_SPAN * sizeof(double));
+  t->b = t->a ? t->a + (size_t)TILE_SPAN * TILE_SPAN : NULL;
+  if (!t->off || !t->stuck || !t->stuck_from || !t->a) return 0;
+
+  // zaseknute policka roztriedene podla dlazdice, v ktorej jadre lezia
+  for (size_t j = 0; j < stuck_count; j++) {
+    int x = (int)(stuck[j] % (size_t)width), y = (int)(stuck[j] / (size_t)width);
+    t->stuck_from[(y / ANALYTIC_TILE) * t->cols + x / ANALYTIC_TILE + 1]++;
+  }
+  for (size_t k = 0; k < count; k++) t->stuck_from[k + 1] += t->stuck_from[k];
+  for (size_t j = 0; j < stuck_count; j++) {
+    int x = (int)(stuck[j] % (size_t)width), y = (int)(stuck[j] / (size_t)width);
+    int tx = x / ANALYTIC_TILE, ty = y / ANALYTIC_TILE;
+    int x0, y0, bw, bh;
+    tile_core(t, tx, ty, &x0, &y0, &bw, &bh);
+    size_t lw = (size_t)bw + 2 * ANALYTIC_TILE_STEPS;
+    size_t *slot = &t->stuck_from[ty * t->cols + tx];
+    t->stuck[(*slot)++] = (size_t)(y - y0 + ANALYTIC_TILE_STEPS) * lw + (size_t)(x - x0 + ANALYTIC_TILE_STEPS);
+  }
+  // posunute zaciatky vratit o dlazdicu spat
+  memmove(t->stuck_from + 1, t->stuck_from, count * sizeof(size_t));
+  t->stuck_from[0] = 0;
+
+  size_t total = 0;
+  for (int ty = 0; ty < t->rows; ty++) {
+    for (int tx = 0; tx < t->cols; tx++) {
+      int x0, y0, bw, bh;
+      tile_core(t, tx, ty, &x0, &y0, &bw, &bh);
+      t->off[ty * t->cols + tx] = total;
+      total += (size_t)(bw + 2 * ANALYTIC_TILE_STEPS) * (size_t)(bh + 2 * ANALYTIC_TILE_STEPS);
+    }
+  }
+  if (!stencil_alloc(&t->st, total)) return 0;
+
+  for (int ty = 0; ty < t->rows; ty++) {
+    for (int tx = 0; tx < t->cols; tx++) {
+      int x0, y0, bw, bh;
+      tile_core(t, tx, ty, &x0, &y0, &bw, &bh);
+      int lw = bw + 2 * ANALYTIC_TILE_STEPS, lh = bh + 2 * ANALYTIC_TILE_STEPS;
+      size_t off = t->off[ty * t->cols + tx];
+      tile_load(t, t->st.c + off, st->c, x0, y0, lw, lh);
+      tile_load(t, t->st.n + off, st->n, x0, y0, lw, lh);
+      tile_load(t, t->st.s + off, st->s, x0, y0, lw, lh);
+      tile_load(t, t->st.w + off, st->w, x0, y0, lw, lh);
+      tile_load(t, t->st.e + off, st->e, x0, y0, lw, lh);
+    }
+  }
+  return 1;
+}
+
+static void tiles_free(Tiles *t) {
+  free(t->st.c);
+  free(t->off);
+  free(t->stuck);
+  free(t->stuck_from);
+  free(t->a);
+}
+
+// steps <= ANALYTIC_TILE_STEPS krokov jednej dlazdice z cur do next;
+// cdf (len dlazdica s cielom) dostane hodnotu ciela po kazdom kroku, k
+// stuck sa pripocita hmota zaseknutych policok jadra
+static void tile_run(Tiles *t, int tx, int ty, double *next, const double *cur, int steps,
+                     double *cdf, double *stuck, RowStep step) {
+  int x0, y0, bw, bh;
+  tile_core(t, tx, ty, &x0, &y0, &bw, &bh);
+  int lw = bw + 2 * ANALYTIC_TILE_STEPS, lh = bh + 2 * ANALYTIC_TILE_STEPS;
+  size_t off = t->off[ty * t->cols + tx];
+  Stencil st = { t->st.c + off, t->st.n + off, t->st.s + off, t->st.w + off, t->st.e + off };
+  size_t core = (size_t)ANALYTIC_TILE_STEPS * (size_t)lw + ANALYTIC_TILE_STEPS;
+
+  double *a = t->a, *b = t->b;
+  tile_load(t, a, cur, x0, y0, lw, lh);
+  for (int k = 1; k <= steps; k++) {
+    for (int ly = k; ly < lh - k; ly++) {
+      size_t row = (size_t)ly * (size_t)lw;
+      step(b + row, a + row, a + row - lw, a + row + lw, &st, row, k, lw - k);
+    }
+    if (cdf) cdf[k] = b[core];
+    stuck[k] += stuck_mass(b, t->stuck + t->stuck_from[ty * t->cols + tx],
+                           t->stuck_from[ty * t->cols + tx + 1] - t->stuck_from[ty * t->cols + tx]);
+    double *tmp = a;
+    a = b;
+    b = tmp;
+  }
+
+  for (int ly = 0; ly < bh; ly++) {
+    memcpy(next + (size_t)(y0 + ly) * (size_t)t->width + (size_t)x0, a + core + (size_t)ly * (size_t)lw,
+           (size_t)bw * sizeof(double));
+  }
+}
+
+HitDistribution *analytic_hit_distribution(const World *world, const MoveTable *moves,
+                                           Position start, int max_steps) {
+  int width = world->width;
+  int height = world->height;
+  size_t cells = (size_t)width * (size_t)height;
+  if (max_steps < 0) max_steps = 0;
+
+  HitDistribution *hd = malloc(sizeof(HitDistribution));
+  if (!hd) return NULL;
+  hd->max_steps = max_steps;
+  hd->probability = 0;
+  hd->cdf = calloc((size_t)max_steps + 1, sizeof(double));
+  hd->stuck = calloc((size_t)max_steps + 1, sizeof(double));
+  size_t stuck_count = 0;
+  size_t *stuck = stuck_cells(world, moves, &stuck_count);
+  double *cur = calloc(cells, sizeof(double));
+  double *next = calloc(cells, sizeof(double));
+  Stencil st = {0};
+  Tiles tiles = {0};
+  _Bool tiled = cells >= ANALYTIC_TILE_MIN_CELLS && width >= TILE_SPAN && height >= TILE_SPAN;
+  _Bool ok = hd->cdf && hd->stuck && stuck && cur && next && stencil_alloc(&st, cells);
+
+  RowStep step = row_step;
+#ifdef ANALYTIC_X86
+  if (batch_has_avx2()) step = row_step_avx2;
+  // Hmota daleko od startu klesne do subnormalnych cisel, s ktorymi je
+  // kazda operacia mnohonasobne pomalsia; pocas sirenia sa nuluju (FTZ/DAZ).
+  unsigned csr = _mm_getcsr();
+  _mm_setcsr(csr | 0x8040);
+#endif
+
+  _Bool free_start = world_is_valid_position(world, start) && !world_obstacle_at(world, start.x, start.y);
+  if (ok && free_start) {
+    double p[16][4];
+    mask_probs(moves, p);
+    stencil_build(&st, world, moves, p);
+    if (tiled) {
+      ok = tiles_create(&tiles, &st, width, height, stuck, stuck_count);
+      free(st.c);
+      st.c = NULL;
+    }
+  }
+
+  if (ok && free_start) {
+    cur[world_cell_index(world, start.x, start.y)] = 1.0;
+    hd->cdf[0] = cur[0];
+    hd->stuck[0] = stuck_mass(cur, stuck, stuck_count);
+
+    int k = 0;
+    while (k < max_steps) {
+      if (!tiled) {
+        grid_step(next, cur, &st, width, height, step);
+        hd->cdf[++k] = next[0];
+        hd->stuck[k] = stuck_mass(next, stuck, stuck_count);
+      } else {
+        int steps = max_steps - k < ANALYTIC_TILE_STEPS ? max_steps - k : ANALYTIC_TILE_STEPS;
+        for (int ty = 0; ty < tiles.rows; ty++) {
+          for (int tx = 0; tx < tiles.cols; tx++) {
+            tile_run(&tiles, tx, ty, next, cur, steps, tx == 0 && ty == 0 ? hd->cdf + k : NULL,
+                     hd->stuck + k, step);
+          }
+        }
+        k += steps;
+      }
+      double *tmp = cur;
+      cur = next;
+      next = tmp;
+    }
+    hd->probability = hd->cdf[max_steps];
+  }
+#ifdef ANALYTIC_X86
+  _mm_setcsr(csr);
+#endif
+
+  free(cur);
+  free(next);
+  free(stuck);
+  free(st.c);
+  tiles_free(&tiles);
+  if (!ok) {
+    analytic_hit_distribution_destroy(hd);
+    return NULL;
+  }
+  return hd;
+}
+
+void analytic_hit_distribution_destroy(HitDistribution *hd) {
+  if (!hd) return;
+  free(hd->cdf);
+  free(hd->stuck);
+  free(hd);
+}
@@ -0,0 +1,44 @@
+#ifndef ANALYTIC_H
+#define ANALYTIC_H
+
+#include "world.h"
+#include "move_table.h"
+
+// Pohyb walkera je Markovov retazec na volnych polickach sveta s prechodmi
+// podla MoveTable (tie iste pravdepodobnosti, ake pouziva simulacia), ciel
+// (0,0) je pohlcujuci stav. Vysledky su pre beh bez limitu K.
+
+// Ocakavany pocet krokov do ciela z kazdeho policka.
+typedef struct {
+  int width;
+  int height;
+  double *steps;     // width*height; INFINITY, ak ciel nie je isty (aj prekazky)
+  int iterations;
+  double residual;   // relativna norma rezidua na konci
+} HittingTimes;
+
+// Riesi sa sustava (I - P) T = 1 iteraciou BiCGStab s agregacnym
+// multigridom (bloky 2x2 az po jedno policko) ako predpodmienenim, kym
+// relativne reziduum neklesne pod tolerance.
+HittingTimes *analytic_hitting_times(const World *world, const MoveTable *moves,
+                                     double tolerance, int max_iterations);
+void analytic_hitting_times_destroy(HittingTimes *ht);
+
+// Rozdelenie casu do ciela z jedneho startu pri limite K krokov.
+typedef struct {
+  int max_steps;
+  double *cdf;          // max_steps + 1 hodnot; cdf[k] = P(ciel najneskor po k krokoch)
+  double *stuck;        // max_steps + 1 hodnot; P(beh sa zasekol najneskor po k krokoch)
+  double probability;   // cdf[max_steps], pravdepodobnost uspesneho behu
+} HitDistribution;
+
+// Rozdelenie polohy walkera sa posuva krok po kroku 5-bodovym stencilom
+// (ciel aj zaseknute policko si hmotu necha), takze vysledok je presny bez
+// vzorkovania. Beh na zaseknutom policku skonci, preto sa jeho hmota
+// zbiera do stuck. Velke mriezky sa pocitaju po dlazdiciach s okrajom na
+// niekolko krokov naraz.
+HitDistribution *analytic_hit_distribution(const World *world, const MoveTable *moves,
+                                           Position start, int max_steps);
+void analytic_hit_distribution_destroy(HitDistribution *hd);
+
+#endif
@@ -0,0 +1,307 @@
+#include "batch.h"
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define BATCH_X86 1
+#endif
+
+_Bool batch_supported(const SimulationConfig *config) {
+  return config->rng == RNG_XOSHIRO256;
+}
+
+_Bool batch_has_avx2(void) {
+#ifdef BATCH_X86
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2") ? 1 : 0;
+#else
+  return 0;
+#endif
+}
+
+void batch_kernel_init(BatchKernel *k, const World *world, const MoveTable *moves, const SimulationConfig *config, _Bool prune) {
+  k->moves = moves;
+  k->width = world->width;
+  k->height = world->height;
+  k->max_steps = config->max_steps_K;
+  k->seed = config->seed;
+  k->use_avx2 = batch_has_avx2();
+  // pred prune_from krokmi je kazda bunka komponentu este dosiahnutelna
+  k->dist = prune ? world->dist : NULL;
+  k->prune_from = prune && config->max_steps_K > world->dist_max ? config->max_steps_K - world->dist_max : 0;
+}
+
+static inline unsigned lane_mask(const BatchKernel *k, const BatchLanes *b, int i) {
+  return k->moves->mask[b->y[i] * k->width + b->x[i]];
+}
+
+// draha, ktora sa uz pohla, sa nezasekne a dokrokovala by do max_steps
+static inline _Bool lane_hopeless(const BatchKernel *k, const BatchLanes *b, int i) {
+  return k->dist && b->steps[i] > k->prune_from &&
+         b->steps[i] + k->dist[b->y[i] * k->width + b->x[i]] > k->max_steps;
+}
+
+static inline _Bool lane_done(const BatchKernel *k, const BatchLanes *b, int i) {
+  return (b->x[i] == 0 && b->y[i] == 0) || b->steps[i] >= k->max_steps ||
+         move_table_stuck(k->moves, lane_mask(k, b, i)) || lane_hopeless(k, b, i);
+}
+
+static void lane_step(const BatchKernel *k, BatchLanes *b, int i) {
+  uint64_t s[4] = { b->s0[i], b->s1[i], b->s2[i], b->s3[i] };
+  uint32_t u = (uint32_t)(rng_xoshiro_next(s) >> 32);
+  b->s0[i] = s[0];
+  b->s1[i] = s[1];
+  b->s2[i] = s[2];
+  b->s3[i] = s[3];
+
+  unsigned mask = lane_mask(k, b, i);
+  if (move_table_stuck(k->moves, mask)) return;
+
+  Position pos = { (int)b->x[i], (int)b->y[i] };
+  pos = move_apply(k->width, k->height, pos, move_table_pick(k->moves, mask, u));
+  b->x[i] = pos.x;
+  b->y[i] = pos.y;
+  b->steps[i]++;
+}
+
+// kazda ziva draha urobi jeden krok, kym niektora neskonci
+static void batch_rounds_scalar(const BatchKernel *k, BatchLanes *b) {
+  while (1) {
+    _Bool finished = 0;
+    for (int i = 0; i < BATCH_LANES; i++) {
+      if (!b->live[i]) continue;
+      lane_step(k, b, i);
+      if (lane_done(k, b, i)) finished = 1;
+    }
+    if (finished) return;
+  }
+}
+
+#ifdef BATCH_X86
+__attribute__((target("avx2")))
+static inline __m256i avx2_rotl(__m256i v, int k) {
+  return _mm256_or_si256(_mm256_slli_epi64(v, k), _mm256_srli_epi64(v, 64 - k));
+}
+
+__attribute__((target("avx2")))
+static void batch_rounds_avx2(const BatchKernel *k, BatchLanes *b) {
+  __m256i s0[2], s1[2], s2[2], s3[2], x[2], y[2], st[2], live[2];
+
+  for (int g = 0; g < 2; g++) {
+    s0[g] = _mm256_loadu_si256((const __m256i*)(b->s0 + 4 * g));
+    s1[g] = _mm256_loadu_si256((const __m256i*)(b->s1 + 4 * g));
+    s2[g] = _mm256_loadu_si256((const __m256i*)(b->s2 + 4 * g));
+    s3[g] = _mm256_loadu_si256((const __m256i*)(b->s3 + 4 * g));
+    x[g] = _mm256_loadu_si256((const __m256i*)(b->x + 4 * g));
+    y[g] = _mm256_loadu_si256((const __m256i*)(b->y + 4 * g));
+    st[g] = _mm256_loadu_si256((const __m256i*)(b->steps + 4 * g));
+    live[g] = _mm256_loadu_si256((const __m256i*)(b->live + 4 * g));
+  }
+
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i three = _mm256_set1_epi64x(3);
+  const __m256i byte = _mm256_set1_epi64x(0xFF);
+  const __m256i dir_down = _mm256_set1_epi64x(MOVE_DOWN);
+  const __m256i dir_up = _mm256_set1_epi64x(MOVE_UP);
+  const __m256i dir_left = _mm256_set1_epi64x(MOVE_LEFT);
+  const __m256i dir_right = _mm256_set1_epi64x(MOVE_RIGHT);
+  const __m256i dir_stuck = _mm256_set1_epi64x(MOVE_STUCK);
+  const __m256i width = _mm256_set1_epi64x(k->width);
+  const __m256i height = _mm256_set1_epi64x(k->height);
+  const __m256i wlast = _mm256_set1_epi64x(k->width - 1);
+  const __m256i hlast = _mm256_set1_epi64x(k->height - 1);
+  const __m256i klast = _mm256_set1_epi64x((int64_t)k->max_steps - 1);
+  const long long *mask_base = (const long long*)k->moves->mask;
+  const int *thr_base = (const int*)&k->moves->threshold[0][0];
+  const long long *dir_base = (const long long*)&k->moves->dir[0][0];
+  const __m256i one = _mm256_set1_epi64x(1);
+  const __m256i stuck_bits = _mm256_set1_epi64x(k->moves->stuck);
+  const __m256i kmax = _mm256_set1_epi64x(k->max_steps);
+  const __m256i prune_from = _mm256_set1_epi64x(k->prune_from);
+  const __m256i word = _mm256_set1_epi64x(0xFFFF);
+  const int *dist_base = (const int*)k->dist;
+
+  // maska otvorenych susedov aktualnej bunky sa prenasa medzi kolami
+  __m256i mask[2];
+  for (int g = 0; g < 2; g++) {
+    __m256i cell = _mm256_add_epi64(_mm256_mul_epu32(y[g], width), x[g]);
+    mask[g] = _mm256_and_si256(_mm256_i64gather_epi64(mask_base, cell, 1), byte);
+  }
+
+  while (1) {
+    __m256i any_done = zero;
+
+    for (int g = 0; g < 2; g++) {
+      // xoshiro256** v styroch drahach naraz, *5 a *9 cez posuny
+      __m256i t5 = _mm256_add_epi64(_mm256_slli_epi64(s1[g], 2), s1[g]);
+      __m256i rot = avx2_rotl(t5, 7);
+      __m256i res = _mm256_add_epi64(_mm256_slli_epi64(rot, 3), rot);
+      __m256i t = _mm256_slli_epi64(s1[g], 17);
+      s2[g] = _mm256_xor_si256(s2[g], s0[g]);
+      s3[g] = _mm256_xor_si256(s3[g], s1[g]);
+      s1[g] = _mm256_xor_si256(s1[g], s2[g]);
+      s0[g] = _mm256_xor_si256(s0[g], s3[g]);
+      s2[g] = _mm256_xor_si256(s2[g], t);
+      s3[g] = avx2_rotl(s3[g], 45);
+      __m256i u = _mm256_srli_epi64(res, 32);
+
+      // prahy pre masku aktualnej bunky
+      __m256i tidx = _mm256_add_epi64(_mm256_add_epi64(mask[g], mask[g]), mask[g]);
+      __m256i t0 = _mm256_cvtepu32_epi64(_mm256_i64gather_epi32(thr_base, tidx, 4));
+      __m256i t1 = _mm256_cvtepu32_epi64(_mm256_i64gather_epi32(thr_base + 1, tidx, 4));
+      __m256i t2 = _mm256_cvtepu32_epi64(_mm256_i64gather_epi32(thr_base + 2, tidx, 4));
+
+      // idx = pocet prahov <= u, cmpgt vracia -1 pre prahy nad u
+      __m256i idx = _mm256_add_epi64(three, _mm256_cmpgt_epi64(t0, u));
+      idx = _mm256_add_epi64(idx, _mm256_cmpgt_epi64(t1, u));
+      idx = _mm256_add_epi64(idx, _mm256_cmpgt_epi64(t2, u));
+      __m256i didx = _mm256_add_epi64(_mm256_slli_epi64(mask[g], 2), idx);
+      __m256i dir = _mm256_and_si256(_mm256_i64gather_epi64(dir_base, didx, 1), byte);
+
+      __m256i stuck = _mm256_cmpeq_epi64(dir, dir_stuck);
+      __m256i moved = _mm256_andnot_si256(stuck, live[g]);
+      __m256i down = _mm256_and_si256(moved, _mm256_cmpeq_epi64(dir, dir_down));
+      __m256i up = _mm256_and_si256(moved, _mm256_cmpeq_epi64(dir, dir_up));
+      __m256i left = _mm256_and_si256(moved, _mm256_cmpeq_epi64(dir, dir_left));
+      __m256i right = _mm256_and_si256(moved, _mm256_cmpeq_epi64(dir, dir_right));
+
+      // masky su -1, preto odcitanie znamena +1
+      __m256i ny = _mm256_add_epi64(_mm256_sub_epi64(y[g], down), up);
+      __m256i nx = _mm256_add_epi64(_mm256_sub_epi64(x[g], right), left);
+      nx = _mm256_blendv_epi8(nx, zero, _mm256_cmpeq_epi64(nx, width));
+      ny = _mm256_blendv_epi8(ny, zero, _mm256_cmpeq_epi64(ny, height));
+      nx = _mm256_blendv_epi8(nx, wlast, _mm256_cmpgt_epi64(zero, nx));
+      ny = _mm256_blendv_epi8(ny, hlast, _mm256_cmpgt_epi64(zero, ny));
+
+      x[g] = nx;
+      y[g] = ny;
+      st[g] = _mm256_sub_epi64(st[g], moved);
+
+      __m256i cell = _mm256_add_epi64(_mm256_mul_epu32(ny, width), nx);
+      mask[g] = _mm256_and_si256(_mm256_i64gather_epi64(mask_base, cell, 1), byte);
+      stuck = _mm256_cmpeq_epi64(_mm256_and_si256(_mm256_srlv_epi64(stuck_bits, mask[g]), one), one);
+
+      __m256i home = _mm256_and_si256(_mm256_cmpeq_epi64(nx, zero), _mm256_cmpeq_epi64(ny, zero));
+      __m256i done = _mm256_or_si256(_mm256_or_si256(home, stuck), _mm256_cmpgt_epi64(st[g], klast));
+
+      // vzdialenost sa cita az na konci rozpoctu, predtym nic neodreze
+      if (dist_base) {
+        __m256i late = _mm256_and_si256(live[g], _mm256_cmpgt_epi64(st[g], prune_from));
+        if (!_mm256_testz_si256(late, late)) {
+          __m256i d = _mm256_and_si256(_mm256_cvtepu32_epi64(_mm256_i64gather_epi32(dist_base, cell, 2)), word);
+          done = _mm256_or_si256(done, _mm256_and_si256(late, _mm256_cmpgt_epi64(_mm256_add_epi64(st[g], d), kmax)));
+        }
+      }
+      any_done = _mm256_or_si256(any_done, _mm256_and_si256(live[g], done));
+    }
+
+    if (!_mm256_testz_si256(any_done, any_done)) break;
+  }
+
+  for (int g = 0; g < 2; g++) {
+    _mm256_storeu_si256((__m256i*)(b->s0 + 4 * g), s0[g]);
+    _mm256_storeu_si256((__m256i*)(b->s1 + 4 * g), s1[g]);
+    _mm256_storeu_si256((__m256i*)(b->s2 + 4 * g), s2[g]);
+    _mm256_storeu_si256((__m256i*)(b->s3 + 4 * g), s3[g]);
+    _mm256_storeu_si256((__m256i*)(b->x + 4 * g), x[g]);
+    _mm256_storeu_si256((__m256i*)(b->y + 4 * g), y[g]);
+    _mm256_storeu_si256((__m256i*)(b->steps + 4 * g), st[g]);
+  }
+}
+#endif
+
+// Drahy koncia v inom poradi, nez zacali. Vysledky sa preto odkladaju do
+// kruhu podla indexu replikacie a do statistik idu v poradi replikacii ako
+// pri Walker-i, takze priemer a M2 su bitovo rovnake na oboch cestach.
+#define BATCH_PENDING 1024
+
+typedef struct {
+  int32_t steps[BATCH_PENDING];
+  uint8_t done[BATCH_PENDING];  // 0 = este bezi, 1 = neuspech, 2 = ciel
+  int recorded;
+} BatchOrder;
+
+static void batch_record(const BatchKernel *k, BatchOrder *o, Statistics *stats, int n, int64_t steps, _Bool success) {
+  int slot = n & (BATCH_PENDING - 1);
+  o->steps[slot] = (int32_t)steps;
+  o->done[slot] = success ? 2 : 1;
+  while (o->done[slot = o->recorded & (BATCH_PENDING - 1)]) {
+    stat_record(stats, o->steps[slot], k->max_steps, o->done[slot] == 2);
+    o->done[slot] = 0;
+    o->recorded++;
+  }
+}
+
+// naplni drahu dalsou replikaciou, trivialne behy vybavi hned; nova
+// replikacia sa nezacne, kym by sa jej vysledok nezmestil do kruhu
+static void batch_fill(const BatchKernel *k, BatchLanes *b, int i, int *lane_rep, Position start, int first_rep, int count,
+                       int *next, BatchOrder *order, Statistics *stats) {
+  b->live[i] = 0;
+  while (*next < count && *next - order->recorded < BATCH_PENDING) {
+    int n = (*next)++;
+
+    if (start.x == 0 && start.y == 0) {
+      batch_record(k, order, stats, n, 0, 1);
+      continue;
+    }
+    if (k->max_steps <= 0) {
+      batch_record(k, order, stats, n, 0, 0);
+      continue;
+    }
+
+    Rng rng;
+    rng_seed(&rng, RNG_XOSHIRO256, k->seed, (uint64_t)(first_rep + n));
+    b->s0[i] = rng.s[0];
+    b->s1[i] = rng.s[1];
+    b->s2[i] = rng.s[2];
+    b->s3[i] = rng.s[3];
+    b->x[i] = start.x;
+    b->y[i] = start.y;
+    b->steps[i] = 0;
+    b->live[i] = -1;
+    lane_rep[i] = n;
+    return;
+  }
+}
+
+void batch_run(const BatchKernel *k, Position start, int first_rep, int count, Statistics *stats) {
+  BatchLanes b;
+  memset(&b, 0, sizeof(b));
+  BatchOrder order;
+  memset(&order, 0, sizeof(order));
+  int lane_rep[BATCH_LANES];
+
+  int next = 0;
+  int live = 0;
+  for (int i = 0; i < BATCH_LANES; i++) {
+    batch_fill(k, &b, i, lane_rep, start, first_rep, count, &next, &order, stats);
+    if (b.live[i]) live++;
+  }
+
+  // najstarsia nezapisana replikacia vzdy bezi v niektorej drahe
+  while (live > 0) {
+#ifdef BATCH_X86
+    if (k->use_avx2) {
+      batch_rounds_avx2(k, &b);
+    } else {
+      batch_rounds_scalar(k, &b);
+    }
+#else
+    batch_rounds_scalar(k, &b);
+#endif
+
+    for (int i = 0; i < BATCH_LANES; i++) {
+      if (!b.live[i] || !lane_done(k, &b, i)) continue;
+      int64_t steps = lane_hopeless(k, &b, i) ? k->max_steps : b.steps[i];
+      batch_record(k, &order, stats, lane_rep[i], steps, b.x[i] == 0 && b.y[i] == 0);
+      b.live[i] = 0;
+      live--;
+    }
+    for (int i = 0; i < BATCH_LANES; i++) {
+      if (b.live[i]) continue;
+      batch_fill(k, &b, i, lane_rep, start, first_rep, count, &next, &order, stats);
+      if (b.live[i]) live++;
+    }
+  }
+}
@@ -0,0 +1,37 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include "simulation.h"
+
+#define BATCH_LANES 8
+
+typedef struct {
+  const MoveTable *moves;
+  int width;
+  int height;
+  int max_steps;
+  uint64_t seed;
+  _Bool use_avx2;
+  // NULL alebo world->dist: draha konci, ked do ciela nestihne dojst
+  const uint16_t *dist;
+  int64_t prune_from;
+} BatchKernel;
+
+// stav vsetkych drahov v SoA tvare, jeden prvok pola = jedna draha
+typedef struct {
+  int64_t x[BATCH_LANES];
+  int64_t y[BATCH_LANES];
+  int64_t steps[BATCH_LANES];
+  int64_t live[BATCH_LANES];
+  uint64_t s0[BATCH_LANES];
+  uint64_t s1[BATCH_LANES];
+  uint64_t s2[BATCH_LANES];
+  uint64_t s3[BATCH_LANES];
+} BatchLanes;
+
+_Bool batch_supported(const SimulationConfig *config);
+_Bool batch_has_avx2(void);
+void batch_kernel_init(BatchKernel *k, const World *world, const MoveTable *moves, const SimulationConfig *config, _Bool prune);
+void batch_run(const BatchKernel *k, Position start, int first_rep, int count, Statistics *stats);
+
+#endif
@@ -0,0 +1,90 @@
+#include "checkpoint.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+void checkpoint_header_init(CheckpointHeader *header, const World *world,
+                            const SimulationConfig *config, Position start) {
+  memset(header, 0, sizeof(*header));
+  memcpy(header->magic, CHECKPOINT_MAGIC, 4);
+  header->version = CHECKPOINT_VERSION;
+  header->width = world->width;
+  header->height = world->height;
+  header->start_x = start.x;
+  header->start_y = start.y;
+  header->max_steps = config->max_steps_K;
+  header->rng = config->rng;
+  header->seed = config->seed;
+  header->probs[0] = config->probs.up;
+  header->probs[1] = config->probs.down;
+  header->probs[2] = config->probs.left;
+  header->probs[3] = config->probs.right;
+  header->world_hash = world_hash(world);
+  header->replication = 0;
+}
+
+_Bool checkpoint_matches(const CheckpointHeader *a, const CheckpointHeader *b) {
+  CheckpointHeader x = *a;
+  x.replication = b->replication;
+  x.output_offset = b->output_offset;
+  x.output_runs = b->output_runs;
+  x.runs_offset = b->runs_offset;
+  return memcmp(&x, b, sizeof(x)) == 0;
+}
+
+_Bool checkpoint_save(const char *path, const CheckpointHeader *header, const Statistics *stats) {
+  size_t len = strlen(path);
+  char *tmp = malloc(len + 5);
+  if (!tmp) return 0;
+  memcpy(tmp, path, len);
+  memcpy(tmp + len, ".tmp", 5);
+
+  FILE *f = fopen(tmp, "wb");
+  if (!f) {
+    free(tmp);
+    return 0;
+  }
+
+  _Bool ok = fwrite(header, sizeof(*header), 1, f) == 1 &&
+             fwrite(stats, sizeof(*stats), 1, f) == 1;
+  ok = ok && fflush(f) == 0 && fsync(fileno(f)) == 0;
+  ok = (fclose(f) == 0) && ok;
+  if (ok) ok = rename(tmp, path) == 0;
+  if (!ok) remove(tmp);
+  free(tmp);
+  return ok;
+}
+
+_Bool checkpoint_load(const char *path, CheckpointHeader *header, Statistics *stats) {
+  FILE *f = fopen(path, "rb");
+  if (!f) return 0;
+
+  _Bool ok = fread(header, sizeof(*header), 1, f) == 1 &&
+             memcmp(header->magic, CHECKPOINT_MAGIC, 4) == 0 &&
+             header->version == CHECKPOINT_VERSION;
+  if (ok && stats) {
+    ok = fread(stats, sizeof(*stats), 1, f) == 1 && stats->total_runs >= 0;
+  }
+  fclose(f);
+  return ok;
+}
+
+uint64_t checkpoint_seed(const char *filename, const SimulationConfig *config, Position start) {
+  size_t len = strlen(filename);
+  char *path = malloc(len + sizeof(CHECKPOINT_EXT));
+  if (!path) return 0;
+  memcpy(path, filename, len);
+  memcpy(path + len, CHECKPOINT_EXT, sizeof(CHECKPOINT_EXT));
+
+  CheckpointHeader h;
+  _Bool ok = checkpoint_load(path, &h, NULL);
+  free(path);
+  // svet sa este nepozna, porovnava sa vsetko ostatne
+  ok = ok && h.width == config->width && h.height == config->height &&
+       h.start_x == start.x && h.start_y == start.y &&
+       h.max_steps == config->max_steps_K && h.rng == (int32_t)config->rng &&
+       h.probs[0] == config->probs.up && h.probs[1] == config->probs.down &&
+       h.probs[2] == config->probs.left && h.probs[3] == config->probs.right;
+  return ok ? h.seed : 0;
+}
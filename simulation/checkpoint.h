@@ -0,0 +1,48 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include "simulation.h"
+
+#include <stdint.h>
+
+// Checkpoint davky (<vystup>.ckpt): hlavicka a za nou zlucene Statistics
+// po poslednom zapocitanom bloku. RNG prud kazdeho behu je urceny dvojicou
+// (seed, replication), takze stav vsetkych prudov je dany seedom a kurzorom
+// replication; beh od kurzora pokracuje presne tam, kde skoncil. Vystupne
+// subory su v case checkpointu na disku presne po kurzor, pri obnove sa na
+// zapisane dlzky skratia (0 = subor nebol otvoreny).
+#define CHECKPOINT_MAGIC "WCKP"
+#define CHECKPOINT_VERSION 2
+#define CHECKPOINT_EXT ".ckpt"
+
+typedef struct {
+  char magic[4];
+  uint32_t version;
+  int32_t width;
+  int32_t height;
+  int32_t start_x;
+  int32_t start_y;
+  int32_t max_steps;
+  int32_t rng;
+  uint64_t seed;
+  double probs[4];  // up, down, left, right
+  uint64_t world_hash;
+  int64_t replication;  // prvy nezapocitany beh
+  uint64_t output_offset;  // dlzka <vystup>
+  uint64_t output_runs;    // zaznamy v .traj indexe
+  uint64_t runs_offset;    // dlzka <vystup>.runs
+} CheckpointHeader;
+
+void checkpoint_header_init(CheckpointHeader *header, const World *world,
+                            const SimulationConfig *config, Position start);
+// ci patri checkpoint k tej istej davke (vsetko okrem kurzora a dlzok)
+_Bool checkpoint_matches(const CheckpointHeader *a, const CheckpointHeader *b);
+// zapis do docasneho suboru a rename, pad pocas zapisu necha stary checkpoint
+_Bool checkpoint_save(const char *path, const CheckpointHeader *header, const Statistics *stats);
+// stats moze byt NULL, ak staci hlavicka
+_Bool checkpoint_load(const char *path, CheckpointHeader *header, Statistics *stats);
+// Seed davky z checkpointu k vystupu filename, ak sa zhoduje so zvyskom
+// konfiguracie (rozmery, start, K, pravdepodobnosti, generator), inak 0.
+uint64_t checkpoint_seed(const char *filename, const SimulationConfig *config, Position start);
+
+#endif
@@ -0,0 +1,366 @@
+#include "engine.h"
+#include "batch.h"
+#include "checkpoint.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// text bloku, po ktorom ho vlakno odovzda vystupu uz pocas behu bloku
+#define ENGINE_SLOT_TEXT (1 << 20)
+
+// Vysledky blokov sa zlucuju vzdy v poradi blokov, takze statistiky aj
+// vystupny subor su rovnake pri lubovolnom pocte vlakien.
+typedef struct {
+  Statistics stats;
+  TrajectoryText out;
+  int first;
+  int count;
+  int steps[ENGINE_CHUNK];
+  _Bool success[ENGINE_CHUNK];
+  _Bool failed;  // nejaky beh sa nepodarilo naformatovat
+  _Bool ready;
+} EngineSlot;
+
+typedef struct {
+  Simulation *sim;
+  Position start;
+  int times;
+  int first_run;
+  int blocks;
+  int next_block;
+  int next_commit;
+  int window;
+  EngineSlot *slots;
+  // bloky sa odovzdavaju vystupu v poradi, na disk ich zapisuje jeho vlakno
+  TrajectoryOutput *output;
+  RunStore *runs;
+  // pri sumarnom behu bez vystupu bezi SoA kernel namiesto Walker-a
+  const BatchKernel *kernel;
+  // >= 0: start je mimo komponentu ciela, kazdy beh ma tolko krokov a neuspeje
+  int lost_steps;
+  _Bool prune;
+  // adaptivny rezim: po zastaveni sa dalsie bloky nerozdavaju a uz
+  // rozdane sa nezapocitaju; committed je pocet zapocitanych behov
+  _Bool adaptive;
+  _Bool stop;
+  int committed;
+  double deadline;
+  // Checkpoint: po zlucenom bloku (najskor v checkpoint_next) sa pod
+  // zamkami len odlozi snimka statistik a oznacia sa vystupy. Subory
+  // dopisuje a checkpoint zapisuje vlakno, ktore snimku vzalo, az mimo
+  // zamkov; checkpointing (pod commit_lock) drzi naraz jedneho pisara.
+  char *checkpoint_path;
+  CheckpointHeader checkpoint;
+  Statistics checkpoint_stats;
+  double checkpoint_next;
+  _Bool checkpointing;
+  // chrani sim->stats, ak volajuci nedodal vlastny mutex
+  pthread_mutex_t *stats_mutex;
+  pthread_mutex_t lock;
+  pthread_mutex_t commit_lock;
+  pthread_cond_t commit_cond;
+} EngineJob;
+
+int engine_default_threads(void) {
+  long n = sysconf(_SC_NPROCESSORS_ONLN);
+  if (n < 1) return 1;
+  if (n > ENGINE_MAX_THREADS) return ENGINE_MAX_THREADS;
+  return (int)n;
+}
+
+static double engine_now(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (double)now.tv_sec + (double)now.tv_nsec * 1e-9;
+}
+
+// Pravidlo zastavenia sa vyhodnoti na zlucenych statistikach po kazdom
+// bloku v poradi blokov, takze (okrem casoveho limitu) zastavi na tom istom
+// behu pri lubovolnom pocte vlakien. Checkpoint je tiez hranica bloku, beh
+// od neho zluci zvysne bloky v rovnakom poradi a vysledok je bitovo rovnaky.
+// Vrati, ci volajuci vzal snimku pre checkpoint.
+static _Bool engine_commit(EngineJob *job, EngineSlot *slot) {
+  _Bool snapshot = 0;
+  pthread_mutex_lock(job->stats_mutex);
+  stat_merge(job->sim->stats, &slot->stats);
+  if (job->adaptive) {
+    job->stop = simulation_precise_enough(job->sim) ||
+                (job->sim->config.time_limit > 0 && engine_now() >= job->deadline);
+  }
+  job->committed += (int)slot->stats.total_runs;
+  if (slot->failed && job->output) trajectory_output_fail(job->output);
+  if (job->checkpoint_path && !job->stop && !job->checkpointing) {
+    double now = engine_now();
+    if (now >= job->checkpoint_next) {
+      job->checkpoint.replication = (int64_t)job->first_run + job->committed;
+      job->checkpoint_stats = *job->sim->stats;
+      job->checkpoint_next = now + job->sim->config.checkpoint_interval;
+      job->checkpointing = snapshot = 1;
+    }
+  }
+  pthread_mutex_unlock(job->stats_mutex);
+
+  if (job->output) {
+    trajectory_output_push(job->output, &slot->out);
+  }
+  if (job->runs) {
+    for (int i = 0; i < slot->count; i++) {
+      run_store_add(job->runs, (uint64_t)(slot->first + i), job->start, slot->steps[i], slot->success[i]);
+    }
+  }
+  // vystupy obsahuju prave behy pred kurzorom snimky
+  if (snapshot) {
+    if (job->output) trajectory_output_mark(job->output);
+    if (job->runs) run_store_mark(job->runs);
+  }
+  return snapshot;
+}
+
+// mimo zamkov: pocka, kym su vystupy po znacku na disku, a az potom
+// zapise checkpoint, ktory na ne ukazuje
+static void engine_checkpoint(EngineJob *job) {
+  CheckpointHeader *h = &job->checkpoint;
+  _Bool ok = 1;
+  h->output_offset = 0;
+  h->output_runs = 0;
+  h->runs_offset = 0;
+  if (job->output) ok = trajectory_output_synced(job->output, &h->output_offset, &h->output_runs) && ok;
+  if (job->runs) ok = run_store_synced(job->runs, &h->runs_offset) && ok;
+  if (ok) checkpoint_save(job->checkpoint_path, h, &job->checkpoint_stats);
+
+  pthread_mutex_lock(&job->commit_lock);
+  job->checkpointing = 0;
+  pthread_mutex_unlock(&job->commit_lock);
+}
+
+// vrati index dalsieho bloku alebo -1, ked je vsetko rozdane
+static int engine_claim(EngineJob *job) {
+  pthread_mutex_lock(&job->commit_lock);
+  int block = -1;
+  if (!job->stop && job->next_block < job->blocks) {
+    block = job->next_block++;
+    while (!job->stop && block >= job->next_commit + job->window) {
+      pthread_cond_wait(&job->commit_cond, &job->commit_lock);
+    }
+    if (job->stop) block = -1;
+  }
+  pthread_mutex_unlock(&job->commit_lock);
+  return block;
+}
+
+static void engine_finish(EngineJob *job, int block) {
+  _Bool snapshot = 0;
+  pthread_mutex_lock(&job->commit_lock);
+  job->slots[block % job->window].ready = 1;
+
+  while (job->next_commit < job->blocks) {
+    EngineSlot *slot = &job->slots[job->next_commit % job->window];
+    if (!slot->ready) break;
+    if (!job->stop && engine_commit(job, slot)) snapshot = 1;
+    slot->ready = 0;
+    job->next_commit++;
+  }
+
+  pthread_cond_broadcast(&job->commit_cond);
+  pthread_mutex_unlock(&job->commit_lock);
+
+  if (snapshot) engine_checkpoint(job);
+}
+
+typedef struct {
+  EngineJob *job;
+  EngineSlot *slot;
+  int block;
+} EngineFlush;
+
+// Plny text bloku sa moze odovzdat vystupu, az ked su vsetky predosle
+// bloky zapocitane; dovtedy vlakno caka. Blok, ktory uz na rade je, sa
+// zapocita urcite, leda by davka medzitym zastala; vtedy sa text zahodi.
+static _Bool engine_flush(void *ctx) {
+  EngineFlush *f = (EngineFlush*)ctx;
+  EngineJob *job = f->job;
+  pthread_mutex_lock(&job->commit_lock);
+  while (!job->stop && job->next_commit != f->block) {
+    pthread_cond_wait(&job->commit_cond, &job->commit_lock);
+  }
+  if (job->stop) f->slot->out.len = 0;
+  else trajectory_output_push(job->output, &f->slot->out);
+  pthread_mutex_unlock(&job->commit_lock);
+  return 1;
+}
+
+static void *engine_worker(void *arg) {
+  EngineJob *job = (EngineJob*)arg;
+  Simulation *sim = job->sim;
+  int max_steps = sim->config.max_steps_K;
+
+  Walker *walker = walker_create(job->start, sim->config.probs);
+  if (!walker) return NULL;
+  walker->moves = sim->moves;
+  walker->prune = job->prune;
+
+  // Beh sa zapisuje rovno do textu bloku. Hlavicka s krokmi a uspechom ide
+  // pred pozicie, preto sa beh najprv prejde bez vystupu a potom sa s tym
+  // istym prudom zopakuje; pamat na vlakno je tak ohranicena aj pri velkom K.
+  EngineFlush flush = { job, NULL, -1 };
+  TrajectoryStream stream;
+  trajectory_stream_init(&stream, job->output, NULL, ENGINE_SLOT_TEXT, engine_flush, &flush);
+  TrajectorySink *sink = job->output ? &stream.sink : NULL;
+
+  int block;
+  while ((block = engine_claim(job)) >= 0) {
+    EngineSlot *slot = &job->slots[block % job->window];
+    int first = block * ENGINE_CHUNK;
+    int last = first + ENGINE_CHUNK;
+    if (last > job->times) last = job->times;
+
+    memset(&slot->stats, 0, sizeof(slot->stats));
+    slot->first = job->first_run + first;
+    slot->count = 0;
+    slot->failed = 0;
+    flush.slot = slot;
+    flush.block = block;
+    stream.text = &slot->out;
+    if (job->kernel) {
+      batch_run(job->kernel, job->start, job->first_run + first, last - first, &slot->stats);
+      engine_finish(job, block);
+      continue;
+    }
+    if (job->lost_steps >= 0) {
+      for (int i = first; i < last; i++) {
+        slot->steps[slot->count] = job->lost_steps;
+        slot->success[slot->count] = 0;
+        slot->count++;
+        stat_record(&slot->stats, job->lost_steps, max_steps, 0);
+      }
+      engine_finish(job, block);
+      continue;
+    }
+
+    for (int i = first; i < last; i++) {
+      int rep = job->first_run + i;
+      walker_reset(walker, job->start);
+      // kazda replikacia ma vlastny prud, vysledok nezavisi od poctu vlakien
+      rng_seed(&walker->rng, sim->config.rng, sim->config.seed, (uint64_t)rep);
+      _Bool success = walker_simulate_to_center(walker, sim->world, max_steps, NULL);
+      int steps = walker_get_steps(walker);
+
+      if (sink && !slot->failed) {
+        walker_reset(walker, job->start);
+        rng_seed(&walker->rng, sim->config.rng, sim->config.seed, (uint64_t)rep);
+        trajectory_stream_expect(&stream, steps, success);
+        stream.failed = 0;
+        trajectory_begin(sink, rep + 1);
+        walker_simulate_to_center(walker, sim->world, max_steps, sink);
+        trajectory_end(sink, steps, success);
+        slot->failed = stream.failed;
+      }
+      slot->steps[slot->count] = steps;
+      slot->success[slot->count] = success;
+      slot->count++;
+
+      stat_record(&slot->stats, steps, max_steps, success);
+    }
+
+    engine_finish(job, block);
+  }
+
+  walker_destroy(walker);
+  return NULL;
+}
+
+_Bool engine_run(Simulation *sim, Position pos, int times, int threads, pthread_mutex_t *mutex) {
+  if (!world_is_accessible(sim->world, pos)) {
+    return 0;
+  }
+  if (times <= 0) {
+    return 1;
+  }
+
+  if (threads <= 0) {
+    threads = engine_default_threads();
+  }
+  if (threads > ENGINE_MAX_THREADS) {
+    threads = ENGINE_MAX_THREADS;
+  }
+  int blocks = (times + ENGINE_CHUNK - 1) / ENGINE_CHUNK;
+  if (threads > blocks) {
+    threads = blocks;
+  }
+
+  EngineJob job;
+  job.sim = sim;
+  job.start = pos;
+  job.times = times;
+  job.first_run = sim->config.current_replication;
+  job.blocks = blocks;
+  job.next_block = 0;
+  job.next_commit = 0;
+  job.window = 2 * threads;
+  job.output = simulation_output(sim);
+  job.runs = simulation_runs(sim);
+  job.adaptive = sim->config.ci_rate > 0 || sim->config.ci_steps > 0 || sim->config.time_limit > 0;
+  job.stop = 0;
+  job.committed = 0;
+  job.deadline = engine_now() + sim->config.time_limit;
+  job.checkpoint_path = NULL;
+  job.checkpointing = 0;
+  if (sim->config.checkpoint_interval > 0) {
+    job.checkpoint_path = simulation_output_path(sim, CHECKPOINT_EXT);
+    checkpoint_header_init(&job.checkpoint, sim->world, &sim->config, pos);
+    job.checkpoint_next = engine_now() + sim->config.checkpoint_interval;
+  }
+  job.slots = calloc((size_t)job.window, sizeof(EngineSlot));
+  if (!job.slots) {
+    free(job.checkpoint_path);
+    return 0;
+  }
+
+  BatchKernel kernel;
+  job.kernel = NULL;
+  job.lost_steps = job.output ? -1 : simulation_unreachable_steps(sim, pos);
+  job.prune = !job.output && job.lost_steps < 0 && simulation_prune_ready(sim, times);
+  if (job.lost_steps < 0 && !job.output && !job.runs && batch_supported(&sim->config)) {
+    batch_kernel_init(&kernel, sim->world, sim->moves, &sim->config, job.prune);
+    job.kernel = &kernel;
+  }
+  pthread_mutex_init(&job.lock, NULL);
+  pthread_mutex_init(&job.commit_lock, NULL);
+  pthread_cond_init(&job.commit_cond, NULL);
+  job.stats_mutex = mutex ? mutex : &job.lock;
+
+  pthread_t tids[ENGINE_MAX_THREADS];
+  int started = 0;
+
+  for (int i = 0; i < threads; i++) {
+    if (pthread_create(&tids[i], NULL, engine_worker, &job) != 0) {
+      break;
+    }
+    started++;
+  }
+
+  // ak sa nepodarilo spustit ani jedno vlakno, pocitame v aktualnom
+  if (started == 0) {
+    engine_worker(&job);
+  }
+
+  for (int i = 0; i < started; i++) {
+    pthread_join(tids[i], NULL);
+  }
+
+  pthread_mutex_lock(job.stats_mutex);
+  sim->config.current_replication += job.committed;
+  if (job.stop) sim->stopped = 1;
+  pthread_mutex_unlock(job.stats_mutex);
+
+  for (int i = 0; i < job.window; i++) {
+    trajectory_text_free(&job.slots[i].out);
+  }
+  free(job.slots);
+  free(job.checkpoint_path);
+  pthread_mutex_destroy(&job.lock);
+  pthread_mutex_destroy(&job.commit_lock);
+  pthread_cond_destroy(&job.commit_cond);
+  return 1;
+}
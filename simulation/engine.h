@@ -0,0 +1,13 @@
+#ifndef ENGINE_H
+#define ENGINE_H
+
+#include "simulation.h"
+#include <pthread.h>
+
+#define ENGINE_MAX_THREADS 256
+#define ENGINE_CHUNK 64
+
+int engine_default_threads(void);
+_Bool engine_run(Simulation *sim, Position pos, int times, int threads, pthread_mutex_t *mutex);
+
+#endif
@@ -0,0 +1,142 @@
+#include "move_table.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define MOVE_SCALE 4294967296.0
+
+// Realne pravdepodobnosti sa rozdelia na presne 2^32 celych dielov metodou
+// najvacsich zvyskov. Zaporne hodnoty sa beru ako 0, ak je vsetko 0, vsetky
+// smery su rovnako pravdepodobne. Sucet nemusi byt 100, hodnoty sa normuju.
+void move_counts(MoveProbabilities probs, uint64_t counts[4]) {
+  double p[4];
+  p[MOVE_DOWN] = probs.down;
+  p[MOVE_UP] = probs.up;
+  p[MOVE_LEFT] = probs.left;
+  p[MOVE_RIGHT] = probs.right;
+
+  double total = 0;
+  for (int d = 0; d < 4; d++) {
+    if (!(p[d] > 0)) p[d] = 0;
+    total += p[d];
+  }
+  if (!(total > 0)) {
+    for (int d = 0; d < 4; d++) counts[d] = (uint64_t)1 << 30;
+    return;
+  }
+
+  double rest[4];
+  uint64_t used = 0;
+  for (int d = 0; d < 4; d++) {
+    double exact = p[d] / total * MOVE_SCALE;
+    counts[d] = (uint64_t)exact;
+    if (counts[d] > ((uint64_t)1 << 32)) counts[d] = (uint64_t)1 << 32;
+    rest[d] = exact - (double)counts[d];
+    used += counts[d];
+  }
+
+  // zvysne diely dostanu smery s najvacsim zvyskom, len tie s nenulovou vahou
+  while (used < ((uint64_t)1 << 32)) {
+    int best = -1;
+    for (int d = 0; d < 4; d++) {
+      if (p[d] > 0 && (best < 0 || rest[d] > rest[best])) best = d;
+    }
+    counts[best]++;
+    rest[best] -= 1.0;
+    used++;
+  }
+  while (used > ((uint64_t)1 << 32)) {
+    int worst = -1;
+    for (int d = 0; d < 4; d++) {
+      if (counts[d] > 0 && (worst < 0 || rest[d] < rest[worst])) worst = d;
+    }
+    counts[worst]--;
+    rest[worst] += 1.0;
+    used--;
+  }
+}
+
+// Prahy pre smery otvorene v maske. Pri plnej maske su to priamo kumulovane
+// pocty, inak sa pocty otvorenych smerov prepocitaju na 2^32 celociselne.
+// Vrati 0, ak sa z bunky s touto maskou neda pohnut.
+_Bool move_choice(const uint64_t counts[4], unsigned mask, uint32_t threshold[3], uint8_t dir[4]) {
+  int dirs[4];
+  uint64_t c[4];
+  uint64_t total = 0;
+  int k = 0;
+
+  for (int d = 0; d < 4; d++) {
+    if ((mask >> d) & 1 && counts[d] > 0) {
+      dirs[k] = d;
+      c[k] = counts[d];
+      total += counts[d];
+      k++;
+    }
+  }
+
+  if (k == 0) {
+    memset(dir, MOVE_STUCK, 4);
+    for (int j = 0; j < 3; j++) threshold[j] = UINT32_MAX;
+    return 0;
+  }
+
+  // prahy pre prvych k-1 smerov, zvysne sloty ukazuju na posledny smer;
+  // kumulovany sucet je mensi ako total <= 2^32, sucin sa zmesti do 64 bitov
+  uint64_t cum = 0;
+  for (int j = 0; j < 3; j++) {
+    if (j < k - 1) {
+      cum += c[j];
+      threshold[j] = (uint32_t)((cum << 32) / total);
+    } else {
+      threshold[j] = UINT32_MAX;
+    }
+  }
+  for (int j = 0; j < 4; j++) {
+    dir[j] = (uint8_t)dirs[j < k ? j : k - 1];
+  }
+  return 1;
+}
+
+MoveTable *move_table_create(const World *world, MoveProbabilities probs) {
+  MoveTable *table = malloc(sizeof(MoveTable));
+  if (!table) return NULL;
+
+  size_t cells = (size_t)world->width * (size_t)world->height;
+  // 8 bajtov navyse pre 64-bitovy gather v batch kerneli
+  table->mask = calloc(cells + 8, 1);
+  if (!table->mask) {
+    free(table);
+    return NULL;
+  }
+  table->width = world->width;
+  table->height = world->height;
+
+  uint64_t counts[4];
+  move_counts(probs, counts);
+  table->stuck = 0;
+  for (unsigned mask = 0; mask < 16; mask++) {
+    if (!move_choice(counts, mask, table->threshold[mask], table->dir[mask])) {
+      table->stuck |= (uint16_t)(1u << mask);
+    }
+  }
+
+  for (int y = 0; y < world->height; y++) {
+    for (int x = 0; x < world->width; x++) {
+      if (world_obstacle_at(world, x, y)) continue;
+      Position pos = {x, y};
+      unsigned mask = 0;
+      for (int d = 0; d < 4; d++) {
+        Position n = move_apply(world->width, world->height, pos, d);
+        if (!world_obstacle_at(world, n.x, n.y)) mask |= 1u << d;
+      }
+      table->mask[world_cell_index(world, x, y)] = (uint8_t)mask;
+    }
+  }
+
+  return table;
+}
+
+void move_table_destroy(MoveTable *table) {
+  if (!table) return;
+  free(table->mask);
+  free(table);
+}
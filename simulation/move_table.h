@@ -0,0 +1,54 @@
+#ifndef MOVE_TABLE_H
+#define MOVE_TABLE_H
+
+#include "world.h"
+
+// smery v poradi, v akom ich vybera walker_move
+#define MOVE_DOWN  0
+#define MOVE_UP    1
+#define MOVE_LEFT  2
+#define MOVE_RIGHT 3
+#define MOVE_STUCK 4
+
+// Bunka ma 4-bitovu masku otvorenych susedov. Pre kazdu zo 16 masiek su
+// pravdepodobnosti prepocitane len na otvorene smery, takze krok je vzdy
+// jedno 32-bitove cislo a jedno porovnanie s prahmi.
+typedef struct {
+  int width;
+  int height;
+  uint32_t threshold[16][3];
+  uint8_t dir[16][4];
+  uint16_t stuck;
+  uint8_t *mask;
+} MoveTable;
+
+MoveTable *move_table_create(const World *world, MoveProbabilities probs);
+void move_table_destroy(MoveTable *table);
+void move_counts(MoveProbabilities probs, uint64_t counts[4]);
+_Bool move_choice(const uint64_t counts[4], unsigned mask, uint32_t threshold[3], uint8_t dir[4]);
+
+// bez vetvenia: index smeru je pocet prahov, ktore u prekrocilo
+static inline int move_pick(const uint32_t threshold[3], const uint8_t dir[4], uint32_t u) {
+  int idx = (u >= threshold[0]) + (u >= threshold[1]) + (u >= threshold[2]);
+  return dir[idx];
+}
+
+static inline _Bool move_table_stuck(const MoveTable *table, unsigned mask) {
+  return (table->stuck >> mask) & 1;
+}
+
+static inline int move_table_pick(const MoveTable *table, unsigned mask, uint32_t u) {
+  return move_pick(table->threshold[mask], table->dir[mask], u);
+}
+
+static inline Position move_apply(int width, int height, Position pos, int dir) {
+  switch (dir) {
+    case MOVE_DOWN:  pos.y = (pos.y + 1 == height) ? 0 : pos.y + 1; break;
+    case MOVE_UP:    pos.y = (pos.y == 0) ? height - 1 : pos.y - 1; break;
+    case MOVE_LEFT:  pos.x = (pos.x == 0) ? width - 1 : pos.x - 1; break;
+    default:         pos.x = (pos.x + 1 == width) ? 0 : pos.x + 1; break;
+  }
+  return pos;
+}
+
+#endif
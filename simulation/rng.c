@@ -0,0 +1,46 @@
+#include "rng.h"
+
+uint64_t rng_mix64(uint64_t x) {
+  x ^= x >> 30;
+  x *= 0xBF58476D1CE4E5B9ULL;
+  x ^= x >> 27;
+  x *= 0x94D049BB133111EBULL;
+  x ^= x >> 31;
+  return x;
+}
+
+static uint64_t splitmix64(uint64_t *state) {
+  *state += 0x9E3779B97F4A7C15ULL;
+  return rng_mix64(*state);
+}
+
+void rng_seed(Rng *rng, RngKind kind, uint64_t seed, uint64_t stream) {
+  rng->kind = kind;
+  rng->buf_idx = 4;
+
+  if (kind == RNG_PHILOX) {
+    rng->s[0] = seed;
+    rng->s[1] = stream;
+    rng->s[2] = 0;
+    rng->s[3] = 0;
+    return;
+  }
+
+  // kazdy (seed, stream) dostane nezavisly pociatocny stav
+  uint64_t sm = rng_mix64(seed) ^ rng_mix64(stream + 0x632BE59BD9B4E019ULL);
+
+  if (kind == RNG_PCG32) {
+    rng->s[0] = 0;
+    rng->s[1] = (stream << 1) | 1u;
+    rng->s[2] = 0;
+    rng->s[3] = 0;
+    rng_pcg_next(rng->s);
+    rng->s[0] += splitmix64(&sm);
+    rng_pcg_next(rng->s);
+    return;
+  }
+
+  for (int i = 0; i < 4; i++) {
+    rng->s[i] = splitmix64(&sm);
+  }
+}
@@ -0,0 +1,119 @@
+#ifndef RNG_H
+#define RNG_H
+
+#include "../common/types.h"
+#include <stdint.h>
+
+// rezervovane prudy, replikacie pouzivaju prud = index replikacie
+#define RNG_STREAM_WORLD       UINT64_MAX
+#define RNG_STREAM_INTERACTIVE (UINT64_MAX - 1)
+
+typedef struct {
+  RngKind kind;
+  uint64_t s[4];
+  uint32_t buf[4];
+  uint32_t buf_idx;
+} Rng;
+
+void rng_seed(Rng *rng, RngKind kind, uint64_t seed, uint64_t stream);
+uint64_t rng_mix64(uint64_t x);
+
+static inline uint64_t rng_rotl(uint64_t x, int k) {
+  return (x << k) | (x >> (64 - k));
+}
+
+static inline uint64_t rng_xoshiro_next(uint64_t *s) {
+  uint64_t result = rng_rotl(s[1] * 5, 7) * 9;
+  uint64_t t = s[1] << 17;
+
+  s[2] ^= s[0];
+  s[3] ^= s[1];
+  s[1] ^= s[2];
+  s[0] ^= s[3];
+  s[2] ^= t;
+  s[3] = rng_rotl(s[3], 45);
+
+  return result;
+}
+
+// PCG-XSH-RR, s[0] je stav, s[1] inkrement (vzdy neparny, urcuje prud)
+static inline uint32_t rng_pcg_next(uint64_t *s) {
+  uint64_t old = s[0];
+  s[0] = old * 6364136223846793005ULL + s[1];
+  uint32_t xorshifted = (uint32_t)(((old >> 18) ^ old) >> 27);
+  uint32_t rot = (uint32_t)(old >> 59);
+  return (xorshifted >> rot) | (xorshifted << ((32 - rot) & 31));
+}
+
+// Philox4x32-10: vystup zavisi len od kluca (seed) a pocitadla
+// (index replikacie, poradie cerpania), nie od predchadzajuceho stavu
+static inline void rng_philox_block(uint32_t out[4], uint64_t key, uint64_t stream, uint64_t ctr) {
+  uint32_t c0 = (uint32_t)ctr, c1 = (uint32_t)(ctr >> 32);
+  uint32_t c2 = (uint32_t)stream, c3 = (uint32_t)(stream >> 32);
+  uint32_t k0 = (uint32_t)key, k1 = (uint32_t)(key >> 32);
+
+  for (int round = 0; round < 10; round++) {
+    uint64_t p0 = (uint64_t)0xD2511F53u * c0;
+    uint64_t p1 = (uint64_t)0xCD9E8D57u * c2;
+    uint32_t n0 = (uint32_t)(p1 >> 32) ^ c1 ^ k0;
+    uint32_t n2 = (uint32_t)(p0 >> 32) ^ c3 ^ k1;
+    c1 = (uint32_t)p1;
+    c3 = (uint32_t)p0;
+    c0 = n0;
+    c2 = n2;
+    k0 += 0x9E3779B9u;
+    k1 += 0xBB67AE85u;
+  }
+
+  out[0] = c0;
+  out[1] = c1;
+  out[2] = c2;
+  out[3] = c3;
+}
+
+static inline uint32_t rng_next_u32(Rng *rng) {
+  if (rng->kind == RNG_PCG32) {
+    return rng_pcg_next(rng->s);
+  }
+  if (rng->kind == RNG_PHILOX) {
+    if (rng->buf_idx >= 4) {
+      rng_philox_block(rng->buf, rng->s[0], rng->s[1], rng->s[2]++);
+      rng->buf_idx = 0;
+    }
+    return rng->buf[rng->buf_idx++];
+  }
+  return (uint32_t)(rng_xoshiro_next(rng->s) >> 32);
+}
+
+// rovnomerne cislo z [0, n) bez modulo skreslenia (Lemire)
+static inline uint32_t rng_bounded(Rng *rng, uint32_t n) {
+  uint64_t m = (uint64_t)rng_next_u32(rng) * n;
+  uint32_t low = (uint32_t)m;
+  if (low < n) {
+    uint32_t threshold = -n % n;
+    while (low < threshold) {
+      m = (uint64_t)rng_next_u32(rng) * n;
+      low = (uint32_t)m;
+    }
+  }
+  return (uint32_t)(m >> 32);
+}
+
+// to iste pre n nad 2^32 (indexy policok velkych svetov), maskou a zamietanim
+static inline uint64_t rng_bounded64(Rng *rng, uint64_t n) {
+  if (n <= UINT32_MAX) return rng_bounded(rng, (uint32_t)n);
+  uint64_t mask = n - 1;
+  mask |= mask >> 1;
+  mask |= mask >> 2;
+  mask |= mask >> 4;
+  mask |= mask >> 8;
+  mask |= mask >> 16;
+  mask |= mask >> 32;
+  uint64_t v;
+  do {
+    v = (((uint64_t)rng_next_u32(rng) << 32) | rng_next_u32(rng)) & mask;
+  } while (v >= n);
+  return v;
+}
+
+#endif
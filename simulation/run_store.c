@@ -0,0 +1,216 @@
+#include "run_store.h"
+#include <stdlib.h>
+#include <string.h>
+
+static size_t block_bytes(uint32_t rows) {
+  size_t bytes = sizeof(RunBlockHeader) + (size_t)rows * (2 * sizeof(uint64_t) + 3 * sizeof(int32_t) + 1);
+  return (bytes + 7) & ~(size_t)7;
+}
+
+static void store_write(void *ctx, const char *data, size_t len) {
+  trajectory_writer_write(&((RunStore*)ctx)->writer, data, len);
+}
+
+static _Bool store_sync(void *ctx, uint64_t *offset, uint64_t *records) {
+  *records = 0;
+  return trajectory_writer_sync(&((RunStore*)ctx)->writer, offset);
+}
+
+static void store_header(RunStoreHeader *header, const World *world, const SimulationConfig *config) {
+  memset(header, 0, sizeof(*header));
+  memcpy(header->magic, RUN_STORE_MAGIC, 4);
+  header->version = RUN_STORE_VERSION;
+  header->width = world->width;
+  header->height = world->height;
+  header->max_steps = config->max_steps_K;
+  header->rng = config->rng;
+  header->seed = config->seed;
+  header->probs[0] = config->probs.up;
+  header->probs[1] = config->probs.down;
+  header->probs[2] = config->probs.left;
+  header->probs[3] = config->probs.right;
+}
+
+// existujuci subor musi mat presne tuto hlavicku, inak sa don nepise
+static _Bool store_check(const char *path, const RunStoreHeader *expected, _Bool *empty) {
+  FILE *f = fopen(path, "rb");
+  *empty = 1;
+  if (!f) return 1;
+
+  RunStoreHeader header;
+  size_t n = fread(&header, 1, sizeof(header), f);
+  fclose(f);
+  if (n == 0) return 1;
+  *empty = 0;
+  return n == sizeof(header) && memcmp(&header, expected, sizeof(header)) == 0;
+}
+
+RunStore *run_store_open(const char *path, const World *world, const SimulationConfig *config) {
+  RunStoreHeader header;
+  _Bool empty;
+  store_header(&header, world, config);
+  if (!store_check(path, &header, &empty)) return NULL;
+
+  RunStore *store = malloc(sizeof(RunStore));
+  if (!store) return NULL;
+  memset(&store->block, 0, sizeof(store->block));
+  store->seed = config->seed;
+  store->rows = 0;
+  store->failed = 0;
+
+  if (!trajectory_writer_open(&store->writer, path)) {
+    free(store);
+    return NULL;
+  }
+
+  if (empty) {
+    trajectory_writer_write(&store->writer, (const char*)&header, sizeof(header));
+  }
+
+  trajectory_queue_start(&store->queue, store_write, store_sync, store);
+  return store;
+}
+
+static void store_flush(RunStore *store) {
+  uint32_t rows = store->rows;
+  if (rows == 0) return;
+
+  size_t bytes = block_bytes(rows);
+  // stratene riadky: subor uz nie je uplny, zatvorenie to ohlasi
+  if (!trajectory_text_reserve(&store->block, bytes)) {
+    store->failed = 1;
+    store->rows = 0;
+    return;
+  }
+  char *p = store->block.data + store->block.len;
+  memset(p, 0, bytes);
+
+  RunBlockHeader header;
+  memcpy(header.magic, RUN_STORE_BLOCK_MAGIC, 4);
+  header.rows = rows;
+  header.first_replication = store->replication[0];
+  memcpy(p, &header, sizeof(header));
+  p += sizeof(header);
+
+  memcpy(p, store->replication, rows * sizeof(uint64_t));
+  p += rows * sizeof(uint64_t);
+  for (uint32_t i = 0; i < rows; i++) {
+    memcpy(p, &store->seed, sizeof(uint64_t));
+    p += sizeof(uint64_t);
+  }
+  memcpy(p, store->start_x, rows * sizeof(int32_t));
+  p += rows * sizeof(int32_t);
+  memcpy(p, store->start_y, rows * sizeof(int32_t));
+  p += rows * sizeof(int32_t);
+  memcpy(p, store->steps, rows * sizeof(int32_t));
+  p += rows * sizeof(int32_t);
+  memcpy(p, store->success, rows);
+
+  store->block.len += bytes;
+  trajectory_queue_push(&store->queue, &store->block);
+  store->rows = 0;
+}
+
+void run_store_add(RunStore *store, uint64_t replication, Position start, int steps, _Bool success) {
+  uint32_t i = store->rows++;
+  store->replication[i] = replication;
+  store->start_x[i] = start.x;
+  store->start_y[i] = start.y;
+  store->steps[i] = steps;
+  store->success[i] = success;
+  if (store->rows == RUN_STORE_BLOCK_ROWS) {
+    store_flush(store);
+  }
+}
+
+// neuplny blok ide von hned, aby znacka pokryla vsetky pridane riadky
+void run_store_mark(RunStore *store) {
+  store_flush(store);
+  trajectory_queue_mark(&store->queue);
+}
+
+_Bool run_store_synced(RunStore *store, uint64_t *offset) {
+  uint64_t records;
+  return trajectory_queue_synced(&store->queue, offset, &records) && !store->failed;
+}
+
+_Bool run_store_close(RunStore *store) {
+  if (!store) return 1;
+  store_flush(store);
+  trajectory_queue_stop(&store->queue);
+  _Bool ok = trajectory_writer_close(&store->writer) && !store->failed;
+  trajectory_text_free(&store->block);
+  free(store);
+  return ok;
+}
+
+_Bool run_reader_open(RunReader *reader, const char *path) {
+  memset(reader, 0, sizeof(*reader));
+  reader->f = fopen(path, "rb");
+  if (!reader->f) return 0;
+
+  if (fread(&reader->header, sizeof(reader->header), 1, reader->f) != 1 ||
+      memcmp(reader->header.magic, RUN_STORE_MAGIC, 4) != 0 ||
+      reader->header.version != RUN_STORE_VERSION) {
+    run_reader_close(reader);
+    return 0;
+  }
+  return 1;
+}
+
+static _Bool read_column(FILE *f, void *dst, size_t size, uint32_t rows) {
+  return fread(dst, size, rows, f) == rows;
+}
+
+_Bool run_reader_next(RunReader *reader) {
+  RunBlockHeader header;
+  reader->rows = 0;
+  if (fread(&header, sizeof(header), 1, reader->f) != 1) return 0;
+  if (memcmp(header.magic, RUN_STORE_BLOCK_MAGIC, 4) != 0 || header.rows == 0) return 0;
+
+  if (header.rows > reader->cap) {
+    uint32_t cap = header.rows;
+    uint64_t *replication = realloc(reader->replication, cap * sizeof(uint64_t));
+    if (replication) reader->replication = replication;
+    uint64_t *seed = realloc(reader->seed, cap * sizeof(uint64_t));
+    if (seed) reader->seed = seed;
+    int32_t *start_x = realloc(reader->start_x, cap * sizeof(int32_t));
+    if (start_x) reader->start_x = start_x;
+    int32_t *start_y = realloc(reader->start_y, cap * sizeof(int32_t));
+    if (start_y) reader->start_y = start_y;
+    int32_t *steps = realloc(reader->steps, cap * sizeof(int32_t));
+    if (steps) reader->steps = steps;
+    uint8_t *success = realloc(reader->success, cap);
+    if (success) reader->success = success;
+    if (!replication || !seed || !start_x || !start_y || !steps || !success) return 0;
+    reader->cap = cap;
+  }
+
+  uint32_t rows = header.rows;
+  if (!read_column(reader->f, reader->replication, sizeof(uint64_t), rows) ||
+      !read_column(reader->f, reader->seed, sizeof(uint64_t), rows) ||
+      !read_column(reader->f, reader->start_x, sizeof(int32_t), rows) ||
+      !read_column(reader->f, reader->start_y, sizeof(int32_t), rows) ||
+      !read_column(reader->f, reader->steps, sizeof(int32_t), rows) ||
+      !read_column(reader->f, reader->success, 1, rows)) {
+    return 0;
+  }
+
+  // vypln na zarovnanie bloku
+  size_t pad = block_bytes(rows) - (sizeof(header) + (size_t)rows * (2 * sizeof(uint64_t) + 3 * sizeof(int32_t) + 1));
+  if (pad > 0 && fseek(reader->f, (long)pad, SEEK_CUR) != 0) return 0;
+
+  reader->rows = rows;
+  return 1;
+}
+
+void run_reader_close(RunReader *reader) {
+  if (reader->f) fclose(reader->f);
+  free(reader->replication);
+  free(reader->seed);
+  free(reader->start_x);
+  free(reader->start_y);
+  free(reader->steps);
+  free(reader->success);
+  memset(reader, 0, sizeof(*reader));
+}
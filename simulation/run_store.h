@@ -0,0 +1,83 @@
+#ifndef RUN_STORE_H
+#define RUN_STORE_H
+
+#include "trajectory.h"
+#include "world.h"
+
+#include <stdint.h>
+
+// Stlpcovy subor s vysledkami jednotlivych behov (<vystup>.runs):
+//   hlavicka | blok | blok | ...
+// Blok ma hlavicku a za nou stlpce pevnej sirky v poradi replication,
+// seed (uint64), start_x, start_y, steps (int32), success (uint8), doplnene
+// nulami na nasobok 8 bajtov. Replication je index behu od 0, zaroven cislo
+// RNG prudu, takze (seed, replication) beh presne zopakuje.
+#define RUN_STORE_MAGIC "WRUN"
+#define RUN_STORE_BLOCK_MAGIC "RBLK"
+#define RUN_STORE_VERSION 1
+#define RUN_STORE_EXT ".runs"
+#define RUN_STORE_BLOCK_ROWS 4096
+
+typedef struct {
+  char magic[4];
+  uint32_t version;
+  int32_t width;
+  int32_t height;
+  int32_t max_steps;
+  int32_t rng;
+  uint64_t seed;
+  double probs[4];  // up, down, left, right
+} RunStoreHeader;
+
+typedef struct {
+  char magic[4];
+  uint32_t rows;
+  uint64_t first_replication;
+} RunBlockHeader;
+
+// Riadky sa zbieraju do stlpcov a cely blok ide cez frontu do suboru.
+typedef struct {
+  TrajectoryWriter writer;
+  TrajectoryQueue queue;
+  TrajectoryText block;
+  uint64_t seed;
+  uint32_t rows;
+  // blok sa nepodarilo pripravit, niektore riadky chybaju
+  _Bool failed;
+  uint64_t replication[RUN_STORE_BLOCK_ROWS];
+  int32_t start_x[RUN_STORE_BLOCK_ROWS];
+  int32_t start_y[RUN_STORE_BLOCK_ROWS];
+  int32_t steps[RUN_STORE_BLOCK_ROWS];
+  uint8_t success[RUN_STORE_BLOCK_ROWS];
+} RunStore;
+
+// Existujuci subor sa doplna len ak ma presne hlavicku tejto konfiguracie.
+RunStore *run_store_open(const char *path, const World *world, const SimulationConfig *config);
+void run_store_add(RunStore *store, uint64_t replication, Position start, int steps, _Bool success);
+// znacka pre checkpoint za posledny pridany riadok a cakanie, kym je subor
+// po nu na disku (pozri trajectory_queue_mark)
+void run_store_mark(RunStore *store);
+// 0 aj vtedy, ak uz nejaky blok chyba
+_Bool run_store_synced(RunStore *store, uint64_t *offset);
+// zapise neuplny blok a zavrie subor; 0, ak subor nie je uplny
+_Bool run_store_close(RunStore *store);
+
+// Citanie po blokoch: po run_reader_next su v stlpcoch rows riadkov.
+typedef struct {
+  FILE *f;
+  RunStoreHeader header;
+  uint32_t rows;
+  uint32_t cap;
+  uint64_t *replication;
+  uint64_t *seed;
+  int32_t *start_x;
+  int32_t *start_y;
+  int32_t *steps;
+  uint8_t *success;
+} RunReader;
+
+_Bool run_reader_open(RunReader *reader, const char *path);
+_Bool run_reader_next(RunReader *reader);
+void run_reader_close(RunReader *reader);
+
+#endif
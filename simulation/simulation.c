@@ -1,66 +1,157 @@
 #include "simulation.h"
+#include "engine.h"
+#include "checkpoint.h"
+#include "trajectory_bin.h"
 #include "world.h"
+#include <limits.h>
+#include <math.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 #include <unistd.h>
+#include <sys/stat.h>
 
 Statistics * stat_create() {
-  Statistics * stats = malloc(sizeof(Statistics));
-  if (stats) {
-    stats->total_steps = 0;
-    stats->max_steps = 0;
-    stats->succ_runs = 0;
-    stats->total_runs = 0;
-  }
-  return stats;
+  return calloc(1, sizeof(Statistics));
 }
 void stat_destroy(Statistics *stat) {
   free(stat);
 }
 
+// priemer a M2 sa zlucuju Chanovym vzorcom; poradie zlucovania je pevne
+// (bloky v poradi), takze aj zaokruhlenie je rovnake pri kazdom behu
+void stat_merge(Statistics *dst, const Statistics *src) {
+  if (src->total_runs > 0) {
+    double na = (double)dst->total_runs;
+    double nb = (double)src->total_runs;
+    double delta = src->mean_steps - dst->mean_steps;
+    dst->mean_steps += delta * nb / (na + nb);
+    dst->m2_steps += src->m2_steps + delta * delta * na * nb / (na + nb);
+  }
+  dst->total_steps += src->total_steps;
+  dst->max_steps += src->max_steps;
+  dst->succ_runs += src->succ_runs;
+  dst->total_runs += src->total_runs;
+  for (int i = 0; i < STAT_HIST_BUCKETS; i++) {
+    dst->hist[i] += src->hist[i];
+  }
+}
+
+void stat_confidence(const Statistics *stats, double *rate_halfwidth, double *steps_halfwidth) {
+  double n = stats->total_runs;
+  if (n < 2) {
+    *rate_halfwidth = INFINITY;
+    *steps_halfwidth = INFINITY;
+    return;
+  }
+  double z = STAT_CI_Z;
+  double p = stats->succ_runs / n;
+  *rate_halfwidth = z / (1.0 + z * z / n) * sqrt(p * (1.0 - p) / n + z * z / (4.0 * n * n));
+
+  *steps_halfwidth = z * sqrt(stats->m2_steps / (n - 1.0) / n);
+}
+
+int64_t stat_quantile(const Statistics *stats, double q) {
+  if (stats->succ_runs <= 0) return -1;
+  // najmensi kos, po ktory je aspon ceil(q * n) uspesnych behov
+  double target = ceil(q * (double)stats->succ_runs);
+  if (target < 1) target = 1;
+  uint64_t seen = 0;
+  for (int i = 0; i < STAT_HIST_BUCKETS; i++) {
+    seen += stats->hist[i];
+    if ((double)seen < target) continue;
+    if (i < 2 * STAT_HIST_SUB) return i;
+    int shift = i / STAT_HIST_SUB - 1;
+    int64_t low = (int64_t)(i - shift * STAT_HIST_SUB) << shift;
+    return low + (((int64_t)1 << shift) - 1) / 2;
+  }
+  return -1;
+}
+
 Simulation * simulation_create(SimulationConfig config) {
   if(config.width <= 0 || config.height <= 0) {
     return NULL;
   }
-  
+
+  World *world = world_create(config.width, config.height);
+  if (!world) return NULL;
+  Simulation *sim = simulation_create_with_world(config, world);
+  if (!sim) world_destroy(world);
+  return sim;
+}
+
+Simulation * simulation_create_with_world(SimulationConfig config, World *world) {
   Simulation * sim = malloc(sizeof(Simulation));
   if (!sim) return NULL;
-  
-  sim->world = world_create(config.width, config.height);
-  if (!sim->world) {
+
+  sim->world = world;
+  sim->moves = move_table_create(sim->world, config.probs);
+  if (!sim->moves) {
     free(sim);
     return NULL;
   }
-  
+
   Position pos =  {config.x , config.y};
   sim->walker = walker_create(pos, config.probs);
   if (!sim->walker) {
-    world_destroy(sim->world);
+    move_table_destroy(sim->moves);
     free(sim);
     return NULL;
   }
+  sim->walker->moves = sim->moves;
+
+  rng_seed(&sim->walker->rng, config.rng, config.seed, RNG_STREAM_INTERACTIVE);
 
   sim->config = config;
   sim->stats = stat_create();
   if (!sim->stats) {
     walker_destroy(sim->walker);
-    world_destroy(sim->world);
+    move_table_destroy(sim->moves);
     free(sim);
     return NULL;
   }
   sim->filename = NULL;
+  sim->output = NULL;
+  sim->runs = NULL;
+  sim->open_failed = 0;
+  trajectory_buffer_init(&sim->traj);
+  memset(&sim->text, 0, sizeof(sim->text));
+  memset(&sim->analytic, 0, sizeof(sim->analytic));
+  sim->stopped = 0;
+  sim->output_failed = 0;
 
   return sim;
 }
 
 void simulation_destroy(Simulation *sim) {
+  simulation_close_output(sim);
   walker_destroy(sim->walker);
+  move_table_destroy(sim->moves);
   world_destroy(sim->world);
   stat_destroy(sim->stats);
+  trajectory_buffer_free(&sim->traj);
+  trajectory_text_free(&sim->text);
   if (sim->filename) free(sim->filename);
   free(sim);
 }
+// vymena sveta spolu s tabulkou krokov, ktora k nemu patri
+_Bool simulation_set_world(Simulation *sim, World *world) {
+  MoveTable *moves = move_table_create(world, sim->config.probs);
+  if (!moves) {
+    return 0;
+  }
+
+  // hlavicka .traj patri k staremu svetu
+  simulation_close_output(sim);
+  move_table_destroy(sim->moves);
+  world_destroy(sim->world);
+  sim->world = world;
+  sim->moves = moves;
+  sim->walker->moves = moves;
+  memset(&sim->analytic, 0, sizeof(sim->analytic));
+  return 1;
+}
+
 _Bool simulation_run(Simulation *sim , Position pos) {
   SimulationConfig config = sim->config;
 
@@ -68,32 +159,40 @@ _Bool simulation_run(Simulation *sim , Position pos) {
         return 0;
       }
       walker_reset(sim->walker, pos);
+      rng_seed(&sim->walker->rng, config.rng, config.seed, (uint64_t)config.current_replication);
       
-      Trajectory * traj = walker_simulate_to_center(sim->walker, sim->world, config.max_steps_K);
-
-      if (sim->filename && strlen(sim->filename) > 0) {
-        FILE *f = fopen(sim->filename, "a");
-        if (f) {
-          int run_no = sim->config.current_replication + 1;
-          fprintf(f, "Run %d:\n", run_no);
-          fprintf(f, "steps=%d success=%d\n", traj->steps_made, walker_has_reached_center(sim->walker));
-          for (int i = 0; i < traj->length; i++) {
-            fprintf(f, "%d %d\n", traj->pos[i].x, traj->pos[i].y);
-          }
-          fprintf(f, "---\n");
-          fclose(f);
-        }
+      TrajectoryOutput *output = simulation_output(sim);
+      TrajectorySink *sink = output ? &sim->traj.sink : NULL;
+
+      // bez trajektorie netreba neuspesny beh krokovat
+      int steps = output ? -1 : simulation_unreachable_steps(sim, pos);
+      _Bool success = 0;
+      if (steps < 0) {
+        sim->walker->prune = !output && simulation_prune_ready(sim, 1);
+        trajectory_begin(sink, sim->config.current_replication + 1);
+        success = walker_simulate_to_center(sim->walker, sim->world, config.max_steps_K, sink);
+        steps = walker_get_steps(sim->walker);
+        trajectory_end(sink, steps, success);
       }
 
-      sim->stats->total_steps += traj->steps_made;
-      sim->stats->total_runs ++;
-      sim->stats->max_steps += config.max_steps_K;
-      sim->config.current_replication++;
+      // zapis na disk robi vlakno vystupu, tu sa beh len naformatuje
+      if (output) {
+        sim->text.len = 0;
+        if (trajectory_output_format(output, &sim->text, &sim->traj)) {
+          trajectory_output_push(output, &sim->text);
+        } else {
+          // neuplny beh sa nezapise, subor sa oznaci ako neuplny
+          trajectory_output_fail(output);
+        }
+      }
 
-      if(walker_has_reached_center(sim->walker)) {
-        sim->stats->succ_runs++;
+      RunStore *runs = simulation_runs(sim);
+      if (runs) {
+        run_store_add(runs, (uint64_t)config.current_replication, pos, steps, success);
       }
-      trajectory_destroy(traj);
+
+      stat_record(sim->stats, steps, config.max_steps_K, success);
+      sim->config.current_replication++;
 
   return 1;
   
@@ -114,60 +213,243 @@ _Bool simulate_interactive(Simulation *sim, pthread_mutex_t *mutex) {
     return 1;
 }
 
-_Bool simulation_run_n_times(Simulation * sim, Position pos, int times) {
-  if (!world_is_accessible(sim->world, pos)) {
-    return 0;
+TrajectoryOutput *simulation_output(Simulation *sim) {
+  if (!sim->output && sim->filename && sim->filename[0] != '\0') {
+    sim->output = trajectory_output_open(sim->filename, sim->world, &sim->config);
+    if (!sim->output) sim->open_failed = 1;
   }
+  return sim->output;
+}
+
+char *simulation_output_path(Simulation *sim, const char *ext) {
+  if (!sim->filename || sim->filename[0] == '\0') return NULL;
+  size_t len = strlen(sim->filename);
+  size_t ext_len = strlen(ext);
+  char *path = malloc(len + ext_len + 1);
+  if (!path) return NULL;
+  memcpy(path, sim->filename, len);
+  memcpy(path + len, ext, ext_len + 1);
+  return path;
+}
 
-  for (int  i = 0; i < times; i++) {
-    simulation_run(sim, pos);
+RunStore *simulation_runs(Simulation *sim) {
+  if (!sim->runs) {
+    char *path = simulation_output_path(sim, RUN_STORE_EXT);
+    if (!path) return NULL;
+    sim->runs = run_store_open(path, sim->world, &sim->config);
+    if (!sim->runs) sim->open_failed = 1;
+    free(path);
   }
+  return sim->runs;
+}
 
-  return 1;
+// pokracuje sa len v davke, ktora este nic nezapocitala
+// subor musi mat aspon dlzku z checkpointu (chybajuci subor len pri 0)
+static _Bool resume_length_ok(const char *path, uint64_t length) {
+  struct stat st;
+  if (!path) return 0;
+  if (stat(path, &st) != 0) return length == 0;
+  return (uint64_t)st.st_size >= length;
+}
+
+static _Bool resume_truncate(const char *path, uint64_t length) {
+  if (length == 0 && access(path, F_OK) != 0) return 1;
+  return truncate(path, (off_t)length) == 0;
+}
+
+// Vystupy sa vratia na stav checkpointu: text a .runs sa skratia za posledny
+// ulozeny beh, .traj dostane index prestavany z blokov. Ak sa to neda,
+// nepokracuje sa (a nic sa neskrati).
+static _Bool resume_outputs(Simulation *sim, const CheckpointHeader *header) {
+  char *runs = simulation_output_path(sim, RUN_STORE_EXT);
+  _Bool binary = trajectory_bin_path(sim->filename);
+  _Bool ok = resume_length_ok(runs, header->runs_offset) &&
+             (binary || resume_length_ok(sim->filename, header->output_offset));
+  if (ok && binary) {
+    ok = header->output_offset > 0
+             ? trajectory_bin_recover(sim->filename, header->output_offset, header->output_runs)
+             : resume_length_ok(sim->filename, 0) && resume_truncate(sim->filename, 0);
+  } else if (ok) {
+    ok = resume_truncate(sim->filename, header->output_offset);
+  }
+  ok = ok && resume_truncate(runs, header->runs_offset);
+  free(runs);
+  return ok;
+}
+
+_Bool simulation_resume(Simulation *sim, Position pos) {
+  if (sim->stats->total_runs != 0) return 0;
+  char *path = simulation_output_path(sim, CHECKPOINT_EXT);
+  if (!path) return 0;
+
+  CheckpointHeader expected, header;
+  Statistics *stats = stat_create();
+  checkpoint_header_init(&expected, sim->world, &sim->config, pos);
+  _Bool ok = stats && checkpoint_load(path, &header, stats) &&
+             checkpoint_matches(&expected, &header) &&
+             header.replication >= 0 && header.replication <= INT_MAX &&
+             !sim->output && !sim->runs && resume_outputs(sim, &header);
+  if (ok) {
+    *sim->stats = *stats;
+    sim->config.current_replication = (int)header.replication;
+  }
+  stat_destroy(stats);
+  free(path);
+  return ok;
+}
+
+void simulation_checkpoint_remove(Simulation *sim) {
+  char *path = simulation_output_path(sim, CHECKPOINT_EXT);
+  if (path) remove(path);
+  free(path);
+}
+
+_Bool simulation_close_output(Simulation *sim) {
+  _Bool ok = trajectory_output_close(sim->output);
+  sim->output = NULL;
+  ok = run_store_close(sim->runs) && ok && !sim->open_failed;
+  sim->runs = NULL;
+  sim->open_failed = 0;
+  return ok;
+}
+
+// Pri kladnych pravdepodobnostiach sa walker zasekne len na bunke bez
+// otvorenych susedov, a to moze byt iba start. Inak spravi vsetkych K krokov.
+int simulation_unreachable_steps(Simulation *sim, Position pos) {
+  const MoveTable *moves = sim->moves;
+  if ((moves->stuck & ~1u) != 0) return -1;
+  if (!world_reach_build(sim->world)) return -1;
+  if (world_reaches_target(sim->world, pos.x, pos.y)) return -1;
+
+  unsigned mask = moves->mask[world_cell_index(sim->world, pos.x, pos.y)];
+  return move_table_stuck(moves, mask) ? 0 : sim->config.max_steps_K;
+}
+
+_Bool simulation_prune_ready(Simulation *sim, int times) {
+  if ((sim->moves->stuck & ~1u) != 0) return 0;
+  if (!sim->world->dist) {
+    uint64_t cells = (uint64_t)sim->world->width * (uint64_t)sim->world->height;
+    if ((uint64_t)sim->config.max_steps_K * (uint64_t)times < cells) return 0;
+  }
+  return world_dist_build(sim->world);
+}
+
+_Bool simulation_precise_enough(Simulation *sim) {
+  const SimulationConfig *c = &sim->config;
+  if (c->ci_rate <= 0 && c->ci_steps <= 0) return 0;
+  if (sim->stats->total_runs < STAT_CI_MIN_RUNS) return 0;
+
+  double rate, steps;
+  stat_confidence(sim->stats, &rate, &steps);
+  return (c->ci_rate <= 0 || rate <= c->ci_rate) && (c->ci_steps <= 0 || steps <= c->ci_steps);
+}
+
+int simulation_remaining(Simulation *sim) {
+  if (sim->stopped) return 0;
+  int64_t remaining = (int64_t)sim->config.total_replications - sim->stats->total_runs;
+  return remaining > 0 ? (int)remaining : 0;
+}
+
+void simulation_analytic(Simulation *sim, Position pos, AnalyticSummary *out) {
+  const AnalyticSummary *cached = &sim->analytic;
+  if (cached->done && cached->start.x == pos.x && cached->start.y == pos.y &&
+      cached->max_steps == sim->config.max_steps_K) {
+    *out = *cached;
+    return;
+  }
+
+  memset(out, 0, sizeof(*out));
+  out->done = 1;
+  out->start = pos;
+  out->max_steps = sim->config.max_steps_K;
+  const World *world = sim->world;
+  uint64_t max_cells = sim->config.exact ? SIM_ANALYTIC_MAX_CELLS : SIM_ANALYTIC_AUTO_CELLS;
+  uint64_t max_work = sim->config.exact ? SIM_ANALYTIC_MAX_WORK : SIM_ANALYTIC_AUTO_WORK;
+  if ((uint64_t)world->width * (uint64_t)world->height > max_cells) return;
+
+  HittingTimes *ht = analytic_hitting_times(world, sim->moves, 1e-10, 1000);
+  if (!ht) return;
+  out->hitting_time = ht->steps[world_cell_index(world, pos.x, pos.y)];
+  out->ready = ht->residual <= 1e-6;
+  analytic_hitting_times_destroy(ht);
+
+  int max_steps = sim->config.max_steps_K;
+  uint64_t work = (uint64_t)world->width * (uint64_t)world->height * (uint64_t)(max_steps > 0 ? max_steps : 1);
+  if (max_steps < 0 || work > max_work) return;
+  HitDistribution *hd = analytic_hit_distribution(world, sim->moves, pos, max_steps);
+  if (!hd) return;
+
+  // Beh konci v ciele, na zaseknutom policku alebo po K krokoch, priemer
+  // krokov je teda sucet P(beh este ide po k krokoch) pre k < K.
+  double mean = 0;
+  for (int k = 0; k < max_steps; k++) mean += 1.0 - hd->cdf[k] - hd->stuck[k];
+  out->rate = hd->probability;
+  out->mean_steps = mean;
+
+  // najmensie k, po ktorom je v ciele podiel q uspesnych behov
+  int64_t *quantile[3] = {&out->p50, &out->p90, &out->p99};
+  double q[3] = {0.5, 0.9, 0.99};
+  for (int i = 0; i < 3; i++) {
+    *quantile[i] = -1;
+    if (hd->probability <= 0) continue;
+    for (int k = 0; k <= max_steps; k++) {
+      if (hd->cdf[k] >= q[i] * hd->probability) {
+        *quantile[i] = k;
+        break;
+      }
+    }
+  }
+  out->distribution = 1;
+  analytic_hit_distribution_destroy(hd);
+}
+
+_Bool simulation_run_n_times(Simulation * sim, Position pos, int times) {
+  return engine_run(sim, pos, times, sim->config.threads, NULL);
 }
 
 _Bool simulation_save_results(Simulation* sim, const char* filename) {
   if (!filename || strlen(filename) == 0) return 0;
+  // suhrn ide az za vsetky behy, ktore este mohli cakat vo fronte
+  _Bool written = simulation_close_output(sim) && !sim->output_failed;
+  // binarny subor ma na konci index, suhrn sa z neho da spocitat (traj2txt)
+  if (trajectory_bin_path(filename)) return written;
   FILE *f = fopen(filename, "a");
   if (!f) return 0;
-  int total = sim->stats->total_runs;
-  int succ = sim->stats->succ_runs;
-  int steps = sim->stats->total_steps;
+  // nejaky beh v subore chyba alebo nie je cely
+  if (!written) fprintf(f, "output_incomplete=1\n");
+  long long total = sim->stats->total_runs;
+  long long succ = sim->stats->succ_runs;
+  long long steps = sim->stats->total_steps;
   double success_rate = total > 0 ? ((double)succ * 100.0) / (double)total : 0.0;
   fprintf(f, "SUMMARY:\n");
-  fprintf(f, "total_runs=%d succ_runs=%d total_steps=%d success_rate=%.2f\n", total, succ, steps, success_rate);
+  fprintf(f, "total_runs=%lld succ_runs=%lld total_steps=%lld success_rate=%.2f\n", total, succ, steps, success_rate);
+  // kvantily krokov uspesnych behov, -1 ak ziadny neuspel
+  fprintf(f, "mean_steps=%.3f sd_steps=%.3f p50=%lld p90=%lld p99=%lld\n", sim->stats->mean_steps,
+          total > 1 ? sqrt(sim->stats->m2_steps / (double)(total - 1)) : 0.0,
+          (long long)stat_quantile(sim->stats, 0.5), (long long)stat_quantile(sim->stats, 0.9),
+          (long long)stat_quantile(sim->stats, 0.99));
+  if (sim->config.ci_rate > 0 || sim->config.ci_steps > 0 || sim->config.time_limit > 0) {
+    double rate, steps_hw;
+    stat_confidence(sim->stats, &rate, &steps_hw);
+    fprintf(f, "ci95_rate=%.6f ci95_steps=%.3f\n", rate, steps_hw);
+  }
+  if (sim->analytic.ready) {
+    fprintf(f, "exact_hitting_time=%.3f\n", sim->analytic.hitting_time);
+  }
+  if (sim->analytic.distribution) {
+    fprintf(f, "exact_rate=%.6f exact_mean_steps=%.3f exact_p50=%lld exact_p90=%lld exact_p99=%lld\n",
+            sim->analytic.rate, sim->analytic.mean_steps, (long long)sim->analytic.p50,
+            (long long)sim->analytic.p90, (long long)sim->analytic.p99);
+  }
   fprintf(f, "EOF\n\n");
-  fclose(f);
-  return 1;
+  return (fclose(f) == 0) && written;
 }
 
 void reset_stats(Statistics *stats) {
-  stats->succ_runs = 0;
-  stats->total_runs = 0;
-  stats->total_steps = 0;
-}
-
-World* create_guaranteed_world(int w, int h, double ratio, Position start) {
-    World* world = NULL;
-    int max_attempts = 100;
-    int attempts = 0;
-    
-    do {
-        if (world) world_destroy(world);
-        world = world_generate_random(w, h, ratio, start);
-        if (!world) return NULL;
-        
-        _Bool has_path = world_has_path(world, start);
-        if (has_path) {
-            return world;
-        }
-        attempts++;
-    } while (attempts < max_attempts);
-    
-    // All attempts failed
-    if (world) {
-        world_destroy(world);
-    }
-    return NULL;
+  memset(stats, 0, sizeof(*stats));
+}
+
+World* create_guaranteed_world(int w, int h, double ratio, Position start, Rng *rng) {
+  return world_generate_connected(w, h, ratio, start, rng);
 }
 
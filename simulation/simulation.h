@@ -4,37 +4,153 @@
 
 #include "walker.h"
 #include "world.h"
+#include "trajectory_out.h"
+#include "run_store.h"
+#include "analytic.h"
 #include <pthread.h>
 
+// Histogram krokov do ciela (len uspesne behy) s logaritmickymi kosmi ako
+// HDR histogram: hodnoty pod 2 * STAT_HIST_SUB su presne, vyssie oktavy
+// [2^k, 2^(k+1)) maju po STAT_HIST_SUB kosov, relativna chyba je teda
+// najviac 1 / STAT_HIST_SUB. Pokryva cely rozsah int.
+#define STAT_HIST_SUB_BITS 5
+#define STAT_HIST_SUB (1 << STAT_HIST_SUB_BITS)
+#define STAT_HIST_BUCKETS ((32 - STAT_HIST_SUB_BITS) * STAT_HIST_SUB)
+
+// Zlucitelny prudovy sumar behov: 64-bitove sucty, priemer a M2 krokov
+// vsetkych behov (Welford) a histogram krokov uspesnych behov.
 typedef struct {
-  int total_steps;
-  int max_steps;
-  int succ_runs;
-  int total_runs;
+  int64_t total_steps;
+  int64_t max_steps;
+  int64_t succ_runs;
+  int64_t total_runs;
+  double mean_steps;
+  double m2_steps;
+  uint64_t hist[STAT_HIST_BUCKETS];
 } Statistics;
 
+// z pre obojstranny 95 % interval; pravidlo zastavenia sa uplatni az od
+// STAT_CI_MIN_RUNS behov, aby ho nezastavil nahodne maly rozptyl
+#define STAT_CI_Z 1.959963984540054
+#define STAT_CI_MIN_RUNS 256
+
+static inline int stat_hist_index(uint32_t steps) {
+  if (steps < 2 * STAT_HIST_SUB) return (int)steps;
+  int shift = 31 - __builtin_clz(steps) - STAT_HIST_SUB_BITS;
+  return shift * STAT_HIST_SUB + (int)(steps >> shift);
+}
+
+static inline void stat_record(Statistics *stats, int steps, int max_steps, _Bool success) {
+  stats->total_steps += steps;
+  stats->total_runs++;
+  stats->max_steps += max_steps;
+  double delta = steps - stats->mean_steps;
+  stats->mean_steps += delta / (double)stats->total_runs;
+  stats->m2_steps += delta * (steps - stats->mean_steps);
+  if (success) {
+    stats->succ_runs++;
+    stats->hist[stat_hist_index((uint32_t)steps)]++;
+  }
+}
+
+// Presne hodnoty pre jeden start z Markovovho retazca (analytic.h) na
+// porovnanie s Monte Carlo. Bez config.exact sa pocitaju len na malych
+// svetoch (SIM_ANALYTIC_AUTO_*), s nim az po SIM_ANALYTIC_MAX_*; rozdelenie
+// do K krokov len ak K * pocet policok nepresiahne limit prace.
+#define SIM_ANALYTIC_MAX_CELLS (1 << 22)
+#define SIM_ANALYTIC_MAX_WORK ((uint64_t)1 << 30)
+#define SIM_ANALYTIC_AUTO_CELLS (1 << 14)
+#define SIM_ANALYTIC_AUTO_WORK ((uint64_t)1 << 24)
+
+typedef struct {
+  _Bool done;     // spocitane pre start a K (svet a pravdepodobnosti sa nemenili)
+  int max_steps;
+  _Bool ready;
+  Position start;
+  double hitting_time;  // E[T] bez limitu K, INFINITY ak ciel nie je isty
+  _Bool distribution;
+  double rate;          // P(ciel najneskor po K krokoch)
+  double mean_steps;    // priemer krokov behu (min(T, K), skor pri zaseknuti)
+  int64_t p50;          // kvantily krokov uspesnych behov, -1 bez nich
+  int64_t p90;
+  int64_t p99;
+} AnalyticSummary;
+
 typedef struct {
   World * world;
+  MoveTable * moves;
   Walker * walker;
   Statistics* stats;
   SimulationConfig config;
 
   char* filename;
+  // otvaraju sa pri prvom zapise, zatvaraju v simulation_close_output;
+  // runs su vysledky behov v <filename>.runs
+  TrajectoryOutput* output;
+  RunStore* runs;
+  // subor sa nepodarilo otvorit (aj cudzi subor, do ktoreho sa nepise)
+  _Bool open_failed;
+  // beh zo simulation_run sa zbiera a formatuje stale do tych istych buffrov
+  TrajectoryBuffer traj;
+  TrajectoryText text;
+  // presne hodnoty k poslednej davke, ide aj do suhrnu; zaroven cache
+  // pre simulation_analytic, pri vymene sveta sa zahodi
+  AnalyticSummary analytic;
+  // adaptivne pravidlo (ci_rate, ci_steps, time_limit) davku ukoncilo,
+  // dalsie behy sa uz nespustaju
+  _Bool stopped;
+  // zapis vystupu zlyhal; nastavuje server pod mutexom, hlasi sa klientovi
+  _Bool output_failed;
 
 }Simulation;
 
 Statistics * stat_create();
 void stat_destroy(Statistics * stat);
+void stat_merge(Statistics * dst, const Statistics * src);
+// polosirky 95 % intervalov: uspesnost (Wilsonov interval) a priemer krokov
+void stat_confidence(const Statistics * stats, double * rate_halfwidth, double * steps_halfwidth);
+// q-kvantil krokov do ciela z histogramu (stred kosa), -1 bez uspesneho behu
+int64_t stat_quantile(const Statistics * stats, double q);
 
 Simulation* simulation_create(SimulationConfig config);
+// Simulacia priamo nad hotovym svetom (aj namapovanym zo suboru), bez
+// prazdneho sveta navyse. Svet prevezme; ak vrati NULL, uvolni ho volajuci.
+Simulation* simulation_create_with_world(SimulationConfig config, World* world);
 void simulation_destroy(Simulation* sim);
+_Bool simulation_set_world(Simulation* sim, World* world);
 _Bool simulation_run(Simulation* sim , Position pos);
 _Bool simulation_run_n_times(Simulation * sim , Position pos , int times);
+TrajectoryOutput* simulation_output(Simulation* sim);
+RunStore* simulation_runs(Simulation* sim);
+// 0, ak sa trajektorie alebo vysledky behov nepodarilo zapisat cele
+_Bool simulation_close_output(Simulation* sim);
+// <filename><ext> alebo NULL bez vystupneho suboru; uvolnuje volajuci
+char* simulation_output_path(Simulation* sim, const char* ext);
+// Obnovi statistiky a kurzor replikacii z checkpointu davky zo startu pos,
+// ak patri k tejto konfiguracii a svetu. Vrati, ci sa pokracuje.
+_Bool simulation_resume(Simulation* sim, Position pos);
+// hotova davka checkpoint nepotrebuje
+void simulation_checkpoint_remove(Simulation* sim);
+// beh zo startu mimo komponentu ciela je neuspesny vopred; vrati jeho pocet
+// krokov, alebo -1, ak sa vysledok neda urcit bez simulacie
+int simulation_unreachable_steps(Simulation* sim, Position pos);
+// ci mozu behy bez trajektorie koncit skoro podla world->dist; pole sa
+// postavi, len ak sa BFS oplati voci ocakavanej praci times behov
+_Bool simulation_prune_ready(Simulation* sim, int times);
+// ci su v adaptivnom rezime dosiahnute pozadovane polosirky (volat pod
+// mutexom statistik)
+_Bool simulation_precise_enough(Simulation* sim);
+// kolko behov este chyba do total_replications, 0 po adaptivnom zastaveni
+int simulation_remaining(Simulation* sim);
+// presne hodnoty zo startu pos do *out (ready = 0, ak je svet privelky);
+// ak su v sim->analytic uz pre ten isty start, len ich skopiruje. sim
+// nemeni, takze moze bezat mimo mutexu; volajuci ulozi *out do sim->analytic
+void simulation_analytic(Simulation* sim, Position pos, AnalyticSummary* out);
 
 void reset_stats(Statistics * stats);
 
 Statistics* simulation_get_statistics(Simulation* sim);
 _Bool simulation_save_results(Simulation* sim, const char* filename);
-World* create_guaranteed_world(int w, int h, double ratio, Position start);
+World* create_guaranteed_world(int w, int h, double ratio, Position start, Rng *rng);
 _Bool simulate_interactive(Simulation *sim,  pthread_mutex_t *mutex); 
 #endif 
@@ -0,0 +1,188 @@
+#include "sweep.h"
+#include "engine.h"
+#include "batch.h"
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+  Simulation *sim;
+  SweepMap *map;
+  const BatchKernel *kernel;
+  _Bool prune;
+  // reach je postaveny, starty mimo komponentu ciela sa nesimuluju
+  _Bool reach;
+  // indexy volnych policok v poradi, v akom sa rozdavaju
+  size_t *order;
+  size_t count;
+  size_t next;
+  pthread_mutex_t *mutex;
+  pthread_mutex_t lock;
+} SweepJob;
+
+SweepMap *sweep_create(const World *world, int replications) {
+  size_t cells = (size_t)world->width * (size_t)world->height;
+  SweepMap *map = malloc(sizeof(SweepMap));
+  if (!map) return NULL;
+  map->width = world->width;
+  map->height = world->height;
+  map->replications = replications;
+  map->avg_steps = calloc(cells, sizeof(double));
+  map->probability = calloc(cells, sizeof(double));
+  map->done = calloc(cells, 1);
+  map->cells_done = 0;
+  map->cells_total = 0;
+  if (!map->avg_steps || !map->probability || !map->done) {
+    sweep_destroy(map);
+    return NULL;
+  }
+  for (int y = 0; y < world->height; y++) {
+    for (int x = 0; x < world->width; x++) {
+      if (!world_obstacle_at(world, x, y)) map->cells_total++;
+    }
+  }
+  return map;
+}
+
+void sweep_destroy(SweepMap *map) {
+  if (!map) return;
+  free(map->avg_steps);
+  free(map->probability);
+  free(map->done);
+  free(map);
+}
+
+// Kluc pre zoradenie: najvzdialenejsie policka prve. Policka mimo komponentu
+// ciela idu s reach na koniec (vysledok bez simulacie), bez neho na zaciatok,
+// lebo kazda ich replikacia prejde vsetkych K krokov.
+static inline unsigned sweep_key(const World *world, size_t i, _Bool reach) {
+  unsigned d = world->dist[i];
+  if (d == WORLD_DIST_NONE) return reach ? WORLD_DIST_NONE : 0;
+  return WORLD_DIST_CAP - d;
+}
+
+// Volne policka zoradene triedenim podla kluca (pocty tried, potom zaciatky).
+static size_t *sweep_order(World *world, size_t count, _Bool reach) {
+  size_t *order = malloc((count > 0 ? count : 1) * sizeof(size_t));
+  if (!order) return NULL;
+  size_t *start = world_dist_build(world) ? calloc((size_t)WORLD_DIST_NONE + 1, sizeof(size_t)) : NULL;
+
+  for (int pass = start ? 0 : 1; pass < 2; pass++) {
+    size_t n = 0;
+    for (int y = 0; y < world->height; y++) {
+      for (int x = 0; x < world->width; x++) {
+        if (world_obstacle_at(world, x, y)) continue;
+        size_t i = world_cell_index(world, x, y);
+        if (!start) order[n++] = i;
+        else if (pass == 0) start[sweep_key(world, i, reach)]++;
+        else order[start[sweep_key(world, i, reach)]++] = i;
+      }
+    }
+    if (pass == 0) {
+      size_t sum = 0;
+      for (size_t k = 0; k <= WORLD_DIST_NONE; k++) {
+        size_t c = start[k];
+        start[k] = sum;
+        sum += c;
+      }
+    }
+  }
+  free(start);
+  return order;
+}
+
+static void sweep_cell(SweepJob *job, Walker *walker, size_t cell, Statistics *stats) {
+  Simulation *sim = job->sim;
+  int reps = job->map->replications;
+  int max_steps = sim->config.max_steps_K;
+  Position start = { (int)(cell % (size_t)sim->world->width), (int)(cell / (size_t)sim->world->width) };
+
+  int lost = job->reach ? simulation_unreachable_steps(sim, start) : -1;
+  if (lost >= 0) {
+    for (int rep = 0; rep < reps; rep++) stat_record(stats, lost, max_steps, 0);
+    return;
+  }
+  if (job->kernel) {
+    batch_run(job->kernel, start, 0, reps, stats);
+    return;
+  }
+  for (int rep = 0; rep < reps; rep++) {
+    walker_reset(walker, start);
+    rng_seed(&walker->rng, sim->config.rng, sim->config.seed, (uint64_t)rep);
+    _Bool success = walker_simulate_to_center(walker, sim->world, max_steps, NULL);
+    stat_record(stats, walker_get_steps(walker), max_steps, success);
+  }
+}
+
+static void *sweep_worker(void *arg) {
+  SweepJob *job = (SweepJob*)arg;
+  Walker *walker = walker_create((Position){0, 0}, job->sim->config.probs);
+  if (!walker) return NULL;
+  walker->moves = job->sim->moves;
+  walker->prune = job->prune;
+
+  while (1) {
+    pthread_mutex_lock(&job->lock);
+    size_t k = job->next < job->count ? job->next++ : job->count;
+    pthread_mutex_unlock(&job->lock);
+    if (k == job->count) break;
+
+    size_t cell = job->order[k];
+    Statistics stats = {0};
+    sweep_cell(job, walker, cell, &stats);
+
+    pthread_mutex_lock(job->mutex);
+    SweepMap *map = job->map;
+    if (stats.total_runs > 0) {
+      map->avg_steps[cell] = (double)stats.total_steps / stats.total_runs;
+      map->probability[cell] = (double)stats.succ_runs / stats.total_runs;
+    }
+    map->done[cell] = 1;
+    map->cells_done++;
+    pthread_mutex_unlock(job->mutex);
+  }
+
+  walker_destroy(walker);
+  return NULL;
+}
+
+_Bool sweep_run(Simulation *sim, SweepMap *map, int threads, pthread_mutex_t *mutex) {
+  if (map->width != sim->world->width || map->height != sim->world->height) return 0;
+
+  SweepJob job;
+  job.sim = sim;
+  job.map = map;
+  job.count = (size_t)map->cells_total;
+  job.next = 0;
+  // indexy sa stavaju tu, vlakna ich uz len citaju
+  job.reach = (sim->moves->stuck & ~1u) == 0 && world_reach_build(sim->world);
+  job.order = sweep_order(sim->world, job.count, job.reach);
+  if (!job.order) return 0;
+  pthread_mutex_init(&job.lock, NULL);
+  job.mutex = mutex ? mutex : &job.lock;
+
+  if (threads <= 0) threads = engine_default_threads();
+  if (threads > ENGINE_MAX_THREADS) threads = ENGINE_MAX_THREADS;
+  if ((size_t)threads > job.count) threads = job.count > 0 ? (int)job.count : 1;
+
+  int64_t work = (int64_t)map->cells_total * map->replications;
+  job.prune = simulation_prune_ready(sim, work > 0x7FFFFFFF ? 0x7FFFFFFF : (int)work);
+  BatchKernel kernel;
+  job.kernel = NULL;
+  if (batch_supported(&sim->config)) {
+    batch_kernel_init(&kernel, sim->world, sim->moves, &sim->config, job.prune);
+    job.kernel = &kernel;
+  }
+
+  pthread_t tids[ENGINE_MAX_THREADS];
+  int started = 0;
+  for (int i = 0; i < threads; i++) {
+    if (pthread_create(&tids[i], NULL, sweep_worker, &job) != 0) break;
+    started++;
+  }
+  if (started == 0) sweep_worker(&job);
+  for (int i = 0; i < started; i++) pthread_join(tids[i], NULL);
+
+  free(job.order);
+  pthread_mutex_destroy(&job.lock);
+  return 1;
+}
@@ -0,0 +1,28 @@
+#ifndef SWEEP_H
+#define SWEEP_H
+
+#include "simulation.h"
+#include <pthread.h>
+
+// Mapa vysledkov zo vsetkych startov: z kazdeho volneho policka sa spusti
+// config.total_replications behov s prudmi 0..n-1, teda rovnako, ako keby
+// bol sumarny beh spusteny z toho policka.
+typedef struct {
+  int width;
+  int height;
+  int replications;
+  double *avg_steps;     // priemer krokov na beh
+  double *probability;   // podiel uspesnych behov
+  uint8_t *done;         // 1, ked je policko hotove (prekazky ostanu 0)
+  int64_t cells_done;
+  int64_t cells_total;
+} SweepMap;
+
+SweepMap *sweep_create(const World *world, int replications);
+void sweep_destroy(SweepMap *map);
+// Policka si vlakna beru po jednom od najvzdialenejsich (najdrahsich) od
+// ciela, takze na konci ostanu lacne a vlakna dobehnu naraz. Hotove
+// policko sa zapise pod mutexom, ak nie je NULL.
+_Bool sweep_run(Simulation *sim, SweepMap *map, int threads, pthread_mutex_t *mutex);
+
+#endif
@@ -0,0 +1,470 @@
+#include "trajectory.h"
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <stdint.h>
+#include <sys/stat.h>
+
+// "x y\n" s dvoma int-mi ma najviac 24 znakov, hlavicka behu najviac 64
+#define POS_TEXT_MAX 24
+static const char digit_pairs[201] =
+  "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+  "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+  "8081828384858687888990919293949596979899";
+
+// zapise cele cislo v desiatkovej sustave, vrati koniec; po dve cifry naraz
+static char *put_int(char *p, int value) {
+  unsigned v = (unsigned)value;
+  if (value < 0) {
+    *p++ = '-';
+    v = 0u - v;
+  }
+
+  char tmp[10];
+  int n = 0;
+  while (v >= 100) {
+    unsigned r = v % 100;
+    v /= 100;
+    tmp[n++] = digit_pairs[2 * r + 1];
+    tmp[n++] = digit_pairs[2 * r];
+  }
+  if (v >= 10) {
+    tmp[n++] = digit_pairs[2 * v + 1];
+    tmp[n++] = digit_pairs[2 * v];
+  } else {
+    tmp[n++] = (char)('0' + v);
+  }
+  while (n > 0) *p++ = tmp[--n];
+  return p;
+}
+
+static char *put_str(char *p, const char *s, size_t len) {
+  memcpy(p, s, len);
+  return p + len;
+}
+
+static char *put_pos(char *p, Position pos) {
+  p = put_int(p, pos.x);
+  *p++ = ' ';
+  p = put_int(p, pos.y);
+  *p++ = '\n';
+  return p;
+}
+
+// "Run N:\nsteps=S success=B\n"
+static char *put_header(char *p, int run_no, int steps, _Bool success) {
+  p = put_str(p, "Run ", 4);
+  p = put_int(p, run_no);
+  p = put_str(p, ":\nsteps=", 8);
+  p = put_int(p, steps);
+  p = put_str(p, " success=", 9);
+  *p++ = success ? '1' : '0';
+  *p++ = '\n';
+  return p;
+}
+
+#define HEADER_TEXT_MAX 64
+
+static void buffer_begin(TrajectorySink *sink, int run_no) {
+  TrajectoryBuffer *buf = (TrajectoryBuffer*)sink;
+  buf->run_no = run_no;
+  buf->length = 0;
+  buf->steps = 0;
+  buf->success = 0;
+  buf->failed = 0;
+  buf->tail = buf->head;
+  if (buf->head) buf->head->length = 0;
+}
+
+static void buffer_pos(TrajectorySink *sink, Position pos) {
+  TrajectoryBuffer *buf = (TrajectoryBuffer*)sink;
+
+  if (!buf->tail || buf->tail->length == TRAJECTORY_CHUNK) {
+    TrajectoryChunk *next = buf->tail ? buf->tail->next : buf->head;
+    if (!next) {
+      next = malloc(sizeof(TrajectoryChunk));
+      if (!next) {
+        buf->failed = 1;
+        return;
+      }
+      next->next = NULL;
+      if (buf->tail) buf->tail->next = next;
+      else buf->head = next;
+    }
+    next->length = 0;
+    buf->tail = next;
+  }
+
+  buf->tail->pos[buf->tail->length++] = pos;
+  buf->length++;
+}
+
+static void buffer_end(TrajectorySink *sink, int steps, _Bool success) {
+  TrajectoryBuffer *buf = (TrajectoryBuffer*)sink;
+  buf->steps = steps;
+  buf->success = success;
+}
+
+void trajectory_buffer_init(TrajectoryBuffer *buf) {
+  memset(buf, 0, sizeof(*buf));
+  buf->sink.begin = buffer_begin;
+  buf->sink.pos = buffer_pos;
+  buf->sink.end = buffer_end;
+}
+
+void trajectory_buffer_free(TrajectoryBuffer *buf) {
+  TrajectoryChunk *chunk = buf->head;
+  while (chunk) {
+    TrajectoryChunk *next = chunk->next;
+    free(chunk);
+    chunk = next;
+  }
+  buf->head = NULL;
+  buf->tail = NULL;
+  buf->length = 0;
+}
+
+static void file_begin(TrajectorySink *sink, int run_no) {
+  TrajectoryFile *file = (TrajectoryFile*)sink;
+  file->run_no = run_no;
+  file->text_len = 0;
+  file->spilled = 0;
+}
+
+// Plny kus textu sa odlozi, kym nie je znama hlavicka behu. Ak sa odlozit
+// neda, beh by v subore chybal len ciastocne; subor sa oznaci ako chybny.
+static void file_spill(TrajectoryFile *file) {
+  if (!file->spill) {
+    file->spill = tmpfile();
+    if (!file->spill) {
+      file->failed = 1;
+      file->text_len = 0;
+      return;
+    }
+  }
+  size_t n = fwrite(file->text, 1, file->text_len, file->spill);
+  if (n != file->text_len) file->failed = 1;
+  file->spilled += n;
+  file->text_len = 0;
+}
+
+static void file_pos(TrajectorySink *sink, Position pos) {
+  TrajectoryFile *file = (TrajectoryFile*)sink;
+
+  if (file->text_len + POS_TEXT_MAX > sizeof(file->text)) file_spill(file);
+  file->text_len = (size_t)(put_pos(file->text + file->text_len, pos) - file->text);
+}
+
+static void file_end(TrajectorySink *sink, int steps, _Bool success) {
+  TrajectoryFile *file = (TrajectoryFile*)sink;
+  FILE *out = file->out;
+
+  char header[HEADER_TEXT_MAX];
+  fwrite(header, 1, (size_t)(put_header(header, file->run_no, steps, success) - header), out);
+
+  if (file->spilled > 0) {
+    char copy[TRAJECTORY_CHUNK];
+    size_t n;
+    fflush(file->spill);
+    rewind(file->spill);
+    while ((n = fread(copy, 1, sizeof(copy), file->spill)) > 0) {
+      if (fwrite(copy, 1, n, out) != n) file->failed = 1;
+    }
+    if (ferror(file->spill)) file->failed = 1;
+    rewind(file->spill);
+    if (ftruncate(fileno(file->spill), 0) != 0) {
+      fclose(file->spill);
+      file->spill = NULL;
+    }
+    file->spilled = 0;
+  }
+
+  fwrite(file->text, 1, file->text_len, out);
+  file->text_len = 0;
+  fwrite("---\n", 1, 4, out);
+}
+
+_Bool trajectory_file_open(TrajectoryFile *file, const char *path) {
+  memset(file, 0, sizeof(*file));
+  file->out = fopen(path, "a");
+  if (!file->out) return 0;
+  file->sink.begin = file_begin;
+  file->sink.pos = file_pos;
+  file->sink.end = file_end;
+  return 1;
+}
+
+_Bool trajectory_file_close(TrajectoryFile *file) {
+  _Bool ok = !file->failed && file->out && !ferror(file->out);
+  if (file->spill) fclose(file->spill);
+  if (file->out && fclose(file->out) != 0) ok = 0;
+  file->spill = NULL;
+  file->out = NULL;
+  return ok;
+}
+
+_Bool trajectory_text_reserve(TrajectoryText *text, size_t extra) {
+  if (text->len + extra <= text->cap) return 1;
+  size_t cap = text->cap ? text->cap : 4096;
+  while (cap < text->len + extra) cap *= 2;
+  char *data = realloc(text->data, cap);
+  if (!data) return 0;
+  text->data = data;
+  text->cap = cap;
+  return 1;
+}
+
+_Bool trajectory_text_header(TrajectoryText *text, int run_no, int steps, _Bool success) {
+  if (!trajectory_text_reserve(text, HEADER_TEXT_MAX)) return 0;
+  text->len = (size_t)(put_header(text->data + text->len, run_no, steps, success) - text->data);
+  return 1;
+}
+
+_Bool trajectory_text_pos(TrajectoryText *text, Position pos) {
+  if (!trajectory_text_reserve(text, POS_TEXT_MAX)) return 0;
+  text->len = (size_t)(put_pos(text->data + text->len, pos) - text->data);
+  return 1;
+}
+
+_Bool trajectory_text_end(TrajectoryText *text) {
+  if (!trajectory_text_reserve(text, 4)) return 0;
+  memcpy(text->data + text->len, "---\n", 4);
+  text->len += 4;
+  return 1;
+}
+
+_Bool trajectory_text_run(TrajectoryText *text, const TrajectoryBuffer *traj) {
+  // beh s chybajucimi poziciami sa nezapise ako cely
+  if (traj->failed || !trajectory_text_header(text, traj->run_no, traj->steps, traj->success)) return 0;
+
+  // miesto sa rezervuje raz na kus, nie pre kazdu poziciu
+  for (const TrajectoryChunk *c = trajectory_buffer_next(traj, NULL); c; c = trajectory_buffer_next(traj, c)) {
+    if (!trajectory_text_reserve(text, (size_t)c->length * POS_TEXT_MAX)) return 0;
+    char *p = text->data + text->len;
+    for (int i = 0; i < c->length; i++) {
+      p = put_pos(p, c->pos[i]);
+    }
+    text->len = (size_t)(p - text->data);
+  }
+  return trajectory_text_end(text);
+}
+
+void trajectory_text_free(TrajectoryText *text) {
+  free(text->data);
+  text->data = NULL;
+  text->len = 0;
+  text->cap = 0;
+}
+
+static void writer_put(TrajectoryWriter *writer, const char *data, size_t len) {
+  while (len > 0 && !writer->failed) {
+    ssize_t n = write(writer->fd, data, len);
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      writer->failed = 1;
+      return;
+    }
+    data += n;
+    len -= (size_t)n;
+  }
+}
+
+_Bool trajectory_writer_open(TrajectoryWriter *writer, const char *path) {
+  memset(writer, 0, sizeof(*writer));
+  writer->fd = -1;
+  writer->buf = malloc(TRAJECTORY_WRITER_BUF);
+  if (!writer->buf) return 0;
+  writer->fd = open(path, O_WRONLY | O_CREAT | O_APPEND, 0644);
+  if (writer->fd < 0) {
+    free(writer->buf);
+    writer->buf = NULL;
+    return 0;
+  }
+  return 1;
+}
+
+void trajectory_writer_write(TrajectoryWriter *writer, const char *data, size_t len) {
+  if (writer->len + len > TRAJECTORY_WRITER_BUF) {
+    writer_put(writer, writer->buf, writer->len);
+    writer->len = 0;
+  }
+  // co je vacsie ako cely buffer, ide rovno do suboru
+  if (len >= TRAJECTORY_WRITER_BUF) {
+    writer_put(writer, data, len);
+    return;
+  }
+  memcpy(writer->buf + writer->len, data, len);
+  writer->len += len;
+}
+
+_Bool trajectory_writer_close(TrajectoryWriter *writer) {
+  if (writer->fd < 0) return 0;
+  writer_put(writer, writer->buf, writer->len);
+  writer->len = 0;
+  if (close(writer->fd) != 0) writer->failed = 1;
+  writer->fd = -1;
+  free(writer->buf);
+  writer->buf = NULL;
+  return !writer->failed;
+}
+
+_Bool trajectory_writer_sync(TrajectoryWriter *writer, uint64_t *size) {
+  if (writer->fd < 0) return 0;
+  writer_put(writer, writer->buf, writer->len);
+  writer->len = 0;
+  struct stat st;
+  if (writer->failed || fsync(writer->fd) != 0 || fstat(writer->fd, &st) != 0) return 0;
+  *size = (uint64_t)st.st_size;
+  return 1;
+}
+
+// Prazdny alebo plny kruh sa neodpytava, strana, ktora nemoze pokracovat,
+// zaspi na podmienke. Pred spanim nastavi priznak a stav kruhu overi znova,
+// druha strana po posune head/tail priznak precita a zobudi ju pod zamkom,
+// takze sa zobudenie nestrati (obe strany pouzivaju seq_cst).
+static void queue_wake(TrajectoryQueue *queue, atomic_bool *sleeping, pthread_cond_t *cond) {
+  if (!atomic_load(sleeping)) return;
+  pthread_mutex_lock(&queue->lock);
+  pthread_cond_signal(cond);
+  pthread_mutex_unlock(&queue->lock);
+}
+
+static void queue_sync(TrajectoryQueue *queue) {
+  uint64_t offset = 0, records = 0;
+  _Bool ok = queue->sync(queue->ctx, &offset, &records);
+  pthread_mutex_lock(&queue->lock);
+  queue->sync_ok = ok;
+  queue->sync_offset = offset;
+  queue->sync_records = records;
+  queue->synced = 1;
+  atomic_store(&queue->sync_at, SIZE_MAX);
+  pthread_cond_broadcast(&queue->synced_cond);
+  pthread_mutex_unlock(&queue->lock);
+}
+
+// bloky sa zapisuju po jednom, aby sa znacka nepreskocila
+static void *queue_thread(void *arg) {
+  TrajectoryQueue *queue = (TrajectoryQueue*)arg;
+  size_t tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+
+  for (;;) {
+    if (atomic_load(&queue->sync_at) == tail) queue_sync(queue);
+
+    size_t head = atomic_load_explicit(&queue->head, memory_order_acquire);
+    if (tail == head) {
+      // closing sa cita az po head, aby sa nestratil posledny blok
+      pthread_mutex_lock(&queue->lock);
+      atomic_store(&queue->writer_sleeping, 1);
+      while (tail == (head = atomic_load(&queue->head)) && !atomic_load(&queue->closing) &&
+             atomic_load(&queue->sync_at) != tail) {
+        pthread_cond_wait(&queue->not_empty, &queue->lock);
+      }
+      atomic_store(&queue->writer_sleeping, 0);
+      pthread_mutex_unlock(&queue->lock);
+      if (tail == head && atomic_load(&queue->sync_at) != tail) break;
+      continue;
+    }
+
+    TrajectoryText *block = &queue->ring[tail % TRAJECTORY_QUEUE_SLOTS];
+    queue->write(queue->ctx, block->data, block->len);
+    block->len = 0;
+    tail++;
+    atomic_store(&queue->tail, tail);
+    queue_wake(queue, &queue->producer_sleeping, &queue->not_full);
+  }
+  return NULL;
+}
+
+void trajectory_queue_start(TrajectoryQueue *queue, void (*write)(void *ctx, const char *data, size_t len),
+                            _Bool (*sync)(void *ctx, uint64_t *offset, uint64_t *records), void *ctx) {
+  memset(queue->ring, 0, sizeof(queue->ring));
+  atomic_init(&queue->head, 0);
+  atomic_init(&queue->tail, 0);
+  atomic_init(&queue->closing, 0);
+  atomic_init(&queue->writer_sleeping, 0);
+  atomic_init(&queue->producer_sleeping, 0);
+  atomic_init(&queue->sync_at, SIZE_MAX);
+  queue->write = write;
+  queue->sync = sync;
+  queue->ctx = ctx;
+  queue->synced = 0;
+  pthread_mutex_init(&queue->lock, NULL);
+  pthread_cond_init(&queue->not_empty, NULL);
+  pthread_cond_init(&queue->not_full, NULL);
+  pthread_cond_init(&queue->synced_cond, NULL);
+  // bez vlakna sa zapisuje synchronne priamo v push
+  queue->started = pthread_create(&queue->thread, NULL, queue_thread, queue) == 0;
+}
+
+void trajectory_queue_push(TrajectoryQueue *queue, TrajectoryText *text) {
+  if (text->len == 0) return;
+  if (!queue->started) {
+    queue->write(queue->ctx, text->data, text->len);
+    text->len = 0;
+    return;
+  }
+
+  size_t head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+  if (head - atomic_load_explicit(&queue->tail, memory_order_acquire) == TRAJECTORY_QUEUE_SLOTS) {
+    pthread_mutex_lock(&queue->lock);
+    atomic_store(&queue->producer_sleeping, 1);
+    while (head - atomic_load(&queue->tail) == TRAJECTORY_QUEUE_SLOTS) {
+      pthread_cond_wait(&queue->not_full, &queue->lock);
+    }
+    atomic_store(&queue->producer_sleeping, 0);
+    pthread_mutex_unlock(&queue->lock);
+  }
+
+  TrajectoryText *slot = &queue->ring[head % TRAJECTORY_QUEUE_SLOTS];
+  TrajectoryText done = *slot;
+  *slot = *text;
+  *text = done;
+  text->len = 0;
+  atomic_store(&queue->head, head + 1);
+  queue_wake(queue, &queue->writer_sleeping, &queue->not_empty);
+}
+
+void trajectory_queue_mark(TrajectoryQueue *queue) {
+  if (!queue->started) {
+    queue->synced = 0;
+    queue_sync(queue);
+    return;
+  }
+  pthread_mutex_lock(&queue->lock);
+  queue->synced = 0;
+  atomic_store(&queue->sync_at, atomic_load(&queue->head));
+  pthread_cond_signal(&queue->not_empty);
+  pthread_mutex_unlock(&queue->lock);
+}
+
+_Bool trajectory_queue_synced(TrajectoryQueue *queue, uint64_t *offset, uint64_t *records) {
+  pthread_mutex_lock(&queue->lock);
+  while (!queue->synced) {
+    pthread_cond_wait(&queue->synced_cond, &queue->lock);
+  }
+  _Bool ok = queue->sync_ok;
+  *offset = queue->sync_offset;
+  *records = queue->sync_records;
+  pthread_mutex_unlock(&queue->lock);
+  return ok;
+}
+
+void trajectory_queue_stop(TrajectoryQueue *queue) {
+  if (queue->started) {
+    pthread_mutex_lock(&queue->lock);
+    atomic_store(&queue->closing, 1);
+    pthread_cond_signal(&queue->not_empty);
+    pthread_mutex_unlock(&queue->lock);
+    pthread_join(queue->thread, NULL);
+    queue->started = 0;
+  }
+  pthread_mutex_destroy(&queue->lock);
+  pthread_cond_destroy(&queue->not_empty);
+  pthread_cond_destroy(&queue->not_full);
+  pthread_cond_destroy(&queue->synced_cond);
+  for (int i = 0; i < TRAJECTORY_QUEUE_SLOTS; i++) {
+    trajectory_text_free(&queue->ring[i]);
+  }
+}
@@ -0,0 +1,154 @@
+#ifndef TRAJECTORY_H
+#define TRAJECTORY_H
+
+#include "../common/types.h"
+
+#include <stdio.h>
+#include <stddef.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+// pocet pozicii v jednom kuse bufferu, resp. bajtov textu pri zapise do suboru
+#define TRAJECTORY_CHUNK 4096
+
+// Kam ide trajektoria behu. begin/end vola ten, kto pozna cislo behu,
+// pos vola walker pre start a po kazdom kroku. NULL namiesto sinku znamena
+// null sink: trajektoria sa nikam neuklada, rataju sa len statistiky.
+typedef struct TrajectorySink {
+  void (*begin)(struct TrajectorySink *sink, int run_no);
+  void (*pos)(struct TrajectorySink *sink, Position pos);
+  void (*end)(struct TrajectorySink *sink, int steps, _Bool success);
+} TrajectorySink;
+
+static inline void trajectory_begin(TrajectorySink *sink, int run_no) {
+  if (sink) sink->begin(sink, run_no);
+}
+
+static inline void trajectory_end(TrajectorySink *sink, int steps, _Bool success) {
+  if (sink) sink->end(sink, steps, success);
+}
+
+typedef struct TrajectoryChunk {
+  struct TrajectoryChunk *next;
+  int length;
+  Position pos[TRAJECTORY_CHUNK];
+} TrajectoryChunk;
+
+// Pozicie behu v retazi kusov. Kusy ostavaju medzi behmi, takze po prvom
+// dlhom behu uz buffer nealokuje; pamat rastie s dlzkou behu, nie s K.
+// failed znamena, ze sa nejaka pozicia nezmestila a beh nie je cely.
+typedef struct {
+  TrajectorySink sink;
+  TrajectoryChunk *head;
+  TrajectoryChunk *tail;
+  size_t length;
+  int run_no;
+  int steps;
+  _Bool success;
+  _Bool failed;
+} TrajectoryBuffer;
+
+void trajectory_buffer_init(TrajectoryBuffer *buf);
+void trajectory_buffer_free(TrajectoryBuffer *buf);
+
+// iteracia cez kusy posledneho behu
+static inline const TrajectoryChunk *trajectory_buffer_next(const TrajectoryBuffer *buf, const TrajectoryChunk *chunk) {
+  if (!chunk) return buf->length ? buf->head : NULL;
+  return chunk == buf->tail ? NULL : chunk->next;
+}
+
+// Priamy zapis do textoveho suboru v doterajsom formate. Hlavicka so
+// steps/success ide pred pozicie, preto sa text behu drzi v jednom kuse
+// a co sa donho nezmesti, odlozi sa do docasneho suboru.
+typedef struct {
+  TrajectorySink sink;
+  FILE *out;
+  FILE *spill;
+  char text[TRAJECTORY_CHUNK];
+  size_t text_len;
+  size_t spilled;
+  int run_no;
+  _Bool failed;
+} TrajectoryFile;
+
+_Bool trajectory_file_open(TrajectoryFile *file, const char *path);
+// 0, ak sa nejaky beh nepodarilo zapisat cely
+_Bool trajectory_file_close(TrajectoryFile *file);
+
+// Text behov v tom istom formate, formatovany bez printf. Po zapise sa
+// vynuluje len dlzka, alokacia sa pouziva znova.
+typedef struct {
+  char *data;
+  size_t len;
+  size_t cap;
+} TrajectoryText;
+
+_Bool trajectory_text_reserve(TrajectoryText *text, size_t extra);
+// cely beh z bufferu, 0 ak buffer nie je cely alebo chyba pamat
+_Bool trajectory_text_run(TrajectoryText *text, const TrajectoryBuffer *traj);
+// ten isty format po castiach: hlavicka, pozicie a oddelovac behu
+_Bool trajectory_text_header(TrajectoryText *text, int run_no, int steps, _Bool success);
+_Bool trajectory_text_pos(TrajectoryText *text, Position pos);
+_Bool trajectory_text_end(TrajectoryText *text);
+void trajectory_text_free(TrajectoryText *text);
+
+#define TRAJECTORY_WRITER_BUF (1 << 20)
+
+// Subor sa otvori raz na davku a zapisuje sa po blokoch TRAJECTORY_WRITER_BUF.
+typedef struct {
+  int fd;
+  char *buf;
+  size_t len;
+  _Bool failed;
+} TrajectoryWriter;
+
+_Bool trajectory_writer_open(TrajectoryWriter *writer, const char *path);
+void trajectory_writer_write(TrajectoryWriter *writer, const char *data, size_t len);
+_Bool trajectory_writer_close(TrajectoryWriter *writer);
+// dopise buffer, fsync a vrati dlzku suboru
+_Bool trajectory_writer_sync(TrajectoryWriter *writer, uint64_t *size);
+
+#define TRAJECTORY_QUEUE_SLOTS 64
+
+// Ohraniceny lock-free kruhovy buffer hotovych blokov (jeden producent,
+// jeden konzument). Vlakno zapisovaca ich odovzdava funkcii write, takze
+// simulacia na disk nikdy necaka; caka len pri plnom buffri. Necinna strana
+// spi na podmienke, zamok sa berie len pri zaspavani a budeni.
+typedef struct {
+  TrajectoryText ring[TRAJECTORY_QUEUE_SLOTS];
+  atomic_size_t head;
+  atomic_size_t tail;
+  atomic_bool closing;
+  atomic_bool writer_sleeping;
+  atomic_bool producer_sleeping;
+  pthread_mutex_t lock;
+  pthread_cond_t not_empty;
+  pthread_cond_t not_full;
+  void (*write)(void *ctx, const char *data, size_t len);
+  // dopise subor na disk, vrati jeho dlzku a pocet zaznamov (ak ich pozna)
+  _Bool (*sync)(void *ctx, uint64_t *offset, uint64_t *records);
+  void *ctx;
+  pthread_t thread;
+  _Bool started;
+  // znacka pre checkpoint: po zapise sync_at blokov vlakno subor dopise
+  atomic_size_t sync_at;
+  _Bool synced;
+  _Bool sync_ok;
+  uint64_t sync_offset;
+  uint64_t sync_records;
+  pthread_cond_t synced_cond;
+} TrajectoryQueue;
+
+void trajectory_queue_start(TrajectoryQueue *queue, void (*write)(void *ctx, const char *data, size_t len),
+                            _Bool (*sync)(void *ctx, uint64_t *offset, uint64_t *records), void *ctx);
+// Znacka za posledny vlozeny blok (vola producent). Subor sa po nu dopise
+// a zosynchronizuje vo vlakne fronty; naraz moze cakat len jedna znacka.
+void trajectory_queue_mark(TrajectoryQueue *queue);
+// pocka na poslednu znacku, moze volat ktorekolvek vlakno
+_Bool trajectory_queue_synced(TrajectoryQueue *queue, uint64_t *offset, uint64_t *records);
+// blok sa vymeni za uz zapisany buffer, text sa vrati prazdny na dalsie pouzitie
+void trajectory_queue_push(TrajectoryQueue *queue, TrajectoryText *text);
+// dopise vsetko, co je v buffri, a ukonci vlakno
+void trajectory_queue_stop(TrajectoryQueue *queue);
+
+#endif
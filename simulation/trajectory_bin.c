@@ -0,0 +1,323 @@
+#include "trajectory_bin.h"
+#include "move_table.h"
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static size_t packed_bytes(int32_t steps) {
+  return steps > 0 ? ((size_t)steps + 3) / 4 : 0;
+}
+
+_Bool trajectory_bin_path(const char *path) {
+  size_t n = strlen(path);
+  size_t e = strlen(TRAJ_BIN_EXT);
+  return n > e && strcmp(path + n - e, TRAJ_BIN_EXT) == 0;
+}
+
+static _Bool read_trailer(FILE *f, TrajectoryBinTrailer *trailer, TrajectoryBinHeader *header) {
+  if (fseeko(f, 0, SEEK_END) != 0) return 0;
+  off_t size = ftello(f);
+  if (size < (off_t)(sizeof(*header) + sizeof(*trailer))) return 0;
+
+  if (fseeko(f, size - (off_t)sizeof(*trailer), SEEK_SET) != 0) return 0;
+  if (fread(trailer, sizeof(*trailer), 1, f) != 1) return 0;
+  if (memcmp(trailer->magic, TRAJ_BIN_INDEX_MAGIC, sizeof(TRAJ_BIN_INDEX_MAGIC)) != 0) return 0;
+  if (trailer->index_offset + trailer->runs * sizeof(uint64_t) + sizeof(*trailer) != (uint64_t)size) return 0;
+
+  rewind(f);
+  if (fread(header, sizeof(*header), 1, f) != 1) return 0;
+  return memcmp(header->magic, TRAJ_BIN_MAGIC, 4) == 0 && header->version == TRAJ_BIN_VERSION;
+}
+
+static _Bool index_push(TrajectoryBin *bin, uint64_t offset) {
+  if (bin->runs == bin->cap) {
+    uint64_t cap = bin->cap ? bin->cap * 2 : 1024;
+    uint64_t *index = realloc(bin->index, cap * sizeof(uint64_t));
+    if (!index) return 0;
+    bin->index = index;
+    bin->cap = cap;
+  }
+  bin->index[bin->runs++] = offset;
+  return 1;
+}
+
+static void bin_header(TrajectoryBinHeader *header, const World *world, const SimulationConfig *config) {
+  memset(header, 0, sizeof(*header));
+  memcpy(header->magic, TRAJ_BIN_MAGIC, 4);
+  header->version = TRAJ_BIN_VERSION;
+  header->width = world->width;
+  header->height = world->height;
+  header->max_steps = config->max_steps_K;
+  header->rng = config->rng;
+  header->seed = config->seed;
+  header->probs[0] = config->probs.up;
+  header->probs[1] = config->probs.down;
+  header->probs[2] = config->probs.left;
+  header->probs[3] = config->probs.right;
+  header->obstacle_ratio = config->obstacle_ratio;
+  header->obstacle_words = (uint64_t)world->stride * (uint64_t)world->height;
+}
+
+// bitova mapa za hlavickou (f stoji za nou) musi byt presne mapa sveta
+static _Bool bin_same_obstacles(FILE *f, const World *world, uint64_t words) {
+  uint64_t chunk[512];
+  for (uint64_t i = 0; i < words; i += 512) {
+    size_t n = words - i < 512 ? (size_t)(words - i) : 512;
+    if (fread(chunk, sizeof(uint64_t), n, f) != n) return 0;
+    if (memcmp(chunk, world->obstacle + i, n * sizeof(uint64_t)) != 0) return 0;
+  }
+  return 1;
+}
+
+// Pokracovanie v existujucom subore: index do pamate, subor skratit pred
+// index. Subor inej konfiguracie alebo ineho sveta sa nepouzije, jeho
+// hlavicka by k novym zaznamom neplatila.
+static _Bool bin_resume(TrajectoryBin *bin, FILE *f, const char *path, const World *world,
+                        const SimulationConfig *config) {
+  TrajectoryBinTrailer trailer;
+  TrajectoryBinHeader header, expected;
+  if (!read_trailer(f, &trailer, &header)) return 0;
+  bin_header(&expected, world, config);
+  if (memcmp(&header, &expected, sizeof(header)) != 0) return 0;
+  if (!bin_same_obstacles(f, world, header.obstacle_words)) return 0;
+
+  if (fseeko(f, (off_t)trailer.index_offset, SEEK_SET) != 0) return 0;
+  for (uint64_t i = 0; i < trailer.runs; i++) {
+    uint64_t offset;
+    if (fread(&offset, sizeof(offset), 1, f) != 1) return 0;
+    if (!index_push(bin, offset)) return 0;
+  }
+  if (truncate(path, (off_t)trailer.index_offset) != 0) return 0;
+  bin->offset = trailer.index_offset;
+  return 1;
+}
+
+_Bool trajectory_bin_open(TrajectoryBin *bin, const char *path, const World *world, const SimulationConfig *config) {
+  memset(bin, 0, sizeof(*bin));
+  bin->width = world->width;
+  bin->height = world->height;
+
+  FILE *f = fopen(path, "rb");
+  if (f) {
+    _Bool empty = fseeko(f, 0, SEEK_END) == 0 && ftello(f) == 0;
+    _Bool ok = empty || bin_resume(bin, f, path, world, config);
+    fclose(f);
+    // cudzi alebo poskodeny subor neprepisujeme
+    if (!ok) {
+      free(bin->index);
+      return 0;
+    }
+  }
+
+  if (!trajectory_writer_open(&bin->writer, path)) {
+    free(bin->index);
+    return 0;
+  }
+
+  if (bin->offset == 0) {
+    TrajectoryBinHeader header;
+    bin_header(&header, world, config);
+
+    size_t words = (size_t)header.obstacle_words * sizeof(uint64_t);
+    trajectory_writer_write(&bin->writer, (const char*)&header, sizeof(header));
+    trajectory_writer_write(&bin->writer, (const char*)world->obstacle, words);
+    bin->offset = sizeof(header) + words;
+  }
+  return 1;
+}
+
+_Bool trajectory_bin_recover(const char *path, uint64_t length, uint64_t runs) {
+  FILE *f = fopen(path, "r+b");
+  if (!f) return 0;
+
+  TrajectoryBinHeader header;
+  uint64_t *index = malloc(runs ? runs * sizeof(uint64_t) : 1);
+  _Bool ok = index && fseeko(f, 0, SEEK_END) == 0 && ftello(f) >= (off_t)length &&
+             fseeko(f, 0, SEEK_SET) == 0 && fread(&header, sizeof(header), 1, f) == 1 &&
+             memcmp(header.magic, TRAJ_BIN_MAGIC, 4) == 0 && header.version == TRAJ_BIN_VERSION;
+
+  // zaznamy idu za sebou hned za bitovou mapou prekazok
+  uint64_t pos = ok ? sizeof(header) + header.obstacle_words * sizeof(uint64_t) : 0;
+  uint64_t n = 0;
+  while (ok && pos < length) {
+    TrajectoryBinRecord rec;
+    ok = n < runs && fseeko(f, (off_t)pos, SEEK_SET) == 0 && fread(&rec, sizeof(rec), 1, f) == 1 && rec.steps >= 0;
+    if (ok) {
+      index[n++] = pos;
+      pos += sizeof(rec) + packed_bytes(rec.steps);
+    }
+  }
+  ok = ok && pos == length && n == runs;
+
+  if (ok) {
+    TrajectoryBinTrailer trailer;
+    memset(&trailer, 0, sizeof(trailer));
+    trailer.index_offset = length;
+    trailer.runs = runs;
+    memcpy(trailer.magic, TRAJ_BIN_INDEX_MAGIC, sizeof(TRAJ_BIN_INDEX_MAGIC));
+    ok = fflush(f) == 0 && ftruncate(fileno(f), (off_t)length) == 0 && fseeko(f, (off_t)length, SEEK_SET) == 0 &&
+         fwrite(index, sizeof(uint64_t), (size_t)runs, f) == runs && fwrite(&trailer, sizeof(trailer), 1, f) == 1;
+  }
+  ok = (fclose(f) == 0) && ok;
+  free(index);
+  return ok;
+}
+
+// pri sirke/vyske 1 alebo 2 staci prvy zhodny smer
+unsigned trajectory_bin_move(int width, int height, Position a, Position b) {
+  for (int d = 0; d < 4; d++) {
+    Position n = move_apply(width, height, a, d);
+    if (n.x == b.x && n.y == b.y) return (unsigned)d;
+  }
+  return MOVE_DOWN;
+}
+
+_Bool trajectory_bin_header(TrajectoryText *out, int run_no, Position start, int steps, _Bool success) {
+  TrajectoryBinRecord rec;
+  if (!trajectory_text_reserve(out, sizeof(rec))) return 0;
+  rec.run_no = run_no;
+  rec.start_x = start.x;
+  rec.start_y = start.y;
+  rec.steps = steps;
+  rec.success = success;
+  memcpy(out->data + out->len, &rec, sizeof(rec));
+  out->len += sizeof(rec);
+  return 1;
+}
+
+_Bool trajectory_bin_run(TrajectoryText *out, const TrajectoryBuffer *traj, int width, int height) {
+  int32_t steps = traj->length > 0 ? (int32_t)(traj->length - 1) : 0;
+  size_t bytes = packed_bytes(steps);
+  const TrajectoryChunk *c = trajectory_buffer_next(traj, NULL);
+  Position prev = c ? c->pos[0] : (Position){0, 0};
+  if (traj->failed || !trajectory_text_reserve(out, sizeof(TrajectoryBinRecord) + bytes) ||
+      !trajectory_bin_header(out, traj->run_no, prev, steps, traj->success)) {
+    return 0;
+  }
+
+  unsigned char *packed = (unsigned char*)out->data + out->len;
+  memset(packed, 0, bytes);
+  size_t k = 0;
+  int first = 1;
+  for (; c; c = trajectory_buffer_next(traj, c)) {
+    for (int i = first; i < c->length; i++, k++) {
+      unsigned dir = trajectory_bin_move(width, height, prev, c->pos[i]);
+      packed[k >> 2] |= (unsigned char)(dir << (2 * (k & 3)));
+      prev = c->pos[i];
+    }
+    first = 0;
+  }
+
+  out->len += bytes;
+  return 1;
+}
+
+void trajectory_bin_write(TrajectoryBin *bin, const char *data, size_t len) {
+  // Offsety zaznamov sa zistia z ich hlaviciek, dlzka je dana poctom
+  // krokov. Dlhy beh moze prist po castiach, hlavicka je vsak vzdy cela
+  // v prvej casti; pending su bajty krokov, ktore este pridu.
+  uint64_t pos = bin->pending < len ? bin->pending : len;
+  bin->pending -= pos;
+  while (pos + sizeof(TrajectoryBinRecord) <= len) {
+    TrajectoryBinRecord rec;
+    memcpy(&rec, data + pos, sizeof(rec));
+    if (!index_push(bin, bin->offset + pos)) bin->failed = 1;
+    pos += sizeof(rec) + packed_bytes(rec.steps);
+  }
+  if (pos > len) bin->pending = pos - len;
+  trajectory_writer_write(&bin->writer, data, len);
+  bin->offset += len;
+}
+
+_Bool trajectory_bin_close(TrajectoryBin *bin) {
+  TrajectoryBinTrailer trailer;
+  memset(&trailer, 0, sizeof(trailer));
+  trailer.index_offset = bin->offset;
+  trailer.runs = bin->runs;
+  memcpy(trailer.magic, TRAJ_BIN_INDEX_MAGIC, sizeof(TRAJ_BIN_INDEX_MAGIC));
+
+  // neuplny index nezapiseme, subor bez neho sa da obnovit cez recover
+  if (bin->failed) {
+    free(bin->index);
+    bin->index = NULL;
+    trajectory_writer_close(&bin->writer);
+    return 0;
+  }
+  if (bin->runs > 0) {
+    trajectory_writer_write(&bin->writer, (const char*)bin->index, bin->runs * sizeof(uint64_t));
+  }
+  trajectory_writer_write(&bin->writer, (const char*)&trailer, sizeof(trailer));
+  free(bin->index);
+  bin->index = NULL;
+  return trajectory_writer_close(&bin->writer);
+}
+
+_Bool trajectory_reader_open(TrajectoryReader *reader, const char *path) {
+  memset(reader, 0, sizeof(*reader));
+  reader->f = fopen(path, "rb");
+  if (!reader->f) return 0;
+
+  TrajectoryBinTrailer trailer;
+  if (!read_trailer(reader->f, &trailer, &reader->header) ||
+      reader->header.width <= 0 || reader->header.height <= 0) {
+    trajectory_reader_close(reader);
+    return 0;
+  }
+  reader->runs = trailer.runs;
+  reader->index_offset = trailer.index_offset;
+
+  size_t words = (size_t)reader->header.obstacle_words;
+  reader->obstacle = malloc(words ? words * sizeof(uint64_t) : 1);
+  if (!reader->obstacle || fread(reader->obstacle, sizeof(uint64_t), words, reader->f) != words) {
+    trajectory_reader_close(reader);
+    return 0;
+  }
+  return 1;
+}
+
+void trajectory_reader_close(TrajectoryReader *reader) {
+  if (reader->f) fclose(reader->f);
+  free(reader->obstacle);
+  reader->f = NULL;
+  reader->obstacle = NULL;
+}
+
+_Bool trajectory_reader_record(TrajectoryReader *reader, uint64_t n, TrajectoryBinRecord *rec) {
+  if (n >= reader->runs) return 0;
+
+  uint64_t offset;
+  if (fseeko(reader->f, (off_t)(reader->index_offset + n * sizeof(uint64_t)), SEEK_SET) != 0) return 0;
+  if (fread(&offset, sizeof(offset), 1, reader->f) != 1) return 0;
+  if (fseeko(reader->f, (off_t)offset, SEEK_SET) != 0) return 0;
+  return fread(rec, sizeof(*rec), 1, reader->f) == 1;
+}
+
+_Bool trajectory_reader_replay(TrajectoryReader *reader, uint64_t n, TrajectorySink *sink) {
+  TrajectoryBinRecord rec;
+  if (!trajectory_reader_record(reader, n, &rec)) return 0;
+
+  int width = reader->header.width;
+  int height = reader->header.height;
+  Position pos = {rec.start_x, rec.start_y};
+  trajectory_begin(sink, rec.run_no);
+  if (sink) sink->pos(sink, pos);
+
+  // kroky sa citaju po kusoch, pamat nezavisi od dlzky behu
+  unsigned char packed[TRAJECTORY_CHUNK];
+  size_t left = packed_bytes(rec.steps);
+  int32_t step = 0;
+  while (left > 0) {
+    size_t n_bytes = left < sizeof(packed) ? left : sizeof(packed);
+    if (fread(packed, 1, n_bytes, reader->f) != n_bytes) return 0;
+    for (size_t i = 0; i < n_bytes; i++) {
+      for (int j = 0; j < 4 && step < rec.steps; j++, step++) {
+        pos = move_apply(width, height, pos, (packed[i] >> (2 * j)) & 3);
+        if (sink) sink->pos(sink, pos);
+      }
+    }
+    left -= n_bytes;
+  }
+
+  trajectory_end(sink, rec.steps, rec.success != 0);
+  return 1;
+}
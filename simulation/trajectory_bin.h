@@ -0,0 +1,91 @@
+#ifndef TRAJECTORY_BIN_H
+#define TRAJECTORY_BIN_H
+
+#include "trajectory.h"
+#include "world.h"
+
+#include <stdint.h>
+
+// Binarny format trajektorii (subor s priponou .traj):
+//   hlavicka | obstacle bitmapa | zaznamy behov | index offsetov | zaver
+// Zaznam behu je TrajectoryBinRecord a za nim (steps+3)/4 bajtov krokov,
+// kazdy krok 2 bity (MOVE_DOWN..MOVE_RIGHT), od najnizsich bitov. Zaver na
+// konci suboru ukazuje na index, takze beh N sa najde bez citania ostatnych.
+// Cisla su v poradi bajtov stroja, ktory subor zapisal.
+#define TRAJ_BIN_MAGIC "WTRJ"
+#define TRAJ_BIN_INDEX_MAGIC "WTRJIDX"
+#define TRAJ_BIN_VERSION 1
+#define TRAJ_BIN_EXT ".traj"
+
+typedef struct {
+  char magic[4];
+  uint32_t version;
+  int32_t width;
+  int32_t height;
+  int32_t max_steps;
+  int32_t rng;
+  uint64_t seed;
+  double probs[4];  // up, down, left, right
+  double obstacle_ratio;
+  uint64_t obstacle_words;  // za hlavickou, riadky po (width+63)/64 slov
+} TrajectoryBinHeader;
+
+typedef struct {
+  int32_t run_no;
+  int32_t start_x;
+  int32_t start_y;
+  int32_t steps;
+  uint32_t success;
+} TrajectoryBinRecord;
+
+typedef struct {
+  uint64_t index_offset;
+  uint64_t runs;
+  char magic[8];
+} TrajectoryBinTrailer;
+
+// Zapis: existujuci platny subor s rovnakou hlavickou a prekazkami sa otvori
+// na pokracovanie (index sa nacita a zapise znova na koniec), inak sa zalozi
+// novy. Ak sa index nepodari zvacsit, failed a trajectory_bin_close zlyha.
+typedef struct {
+  TrajectoryWriter writer;
+  int width;
+  int height;
+  uint64_t offset;
+  uint64_t *index;
+  uint64_t runs;
+  uint64_t cap;
+  uint64_t pending;  // bajty krokov posledneho zaznamu, ktore este neprisli
+  _Bool failed;
+} TrajectoryBin;
+
+_Bool trajectory_bin_path(const char *path);
+_Bool trajectory_bin_open(TrajectoryBin *bin, const char *path, const World *world, const SimulationConfig *config);
+// zaznam jedneho behu z bufferu do out; zapise sa neskor cez trajectory_bin_write
+_Bool trajectory_bin_run(TrajectoryText *out, const TrajectoryBuffer *traj, int width, int height);
+// ten isty zaznam po castiach: hlavicka a potom smer kazdeho kroku
+_Bool trajectory_bin_header(TrajectoryText *out, int run_no, Position start, int steps, _Bool success);
+// smer, ktorym sa z a dostane do b
+unsigned trajectory_bin_move(int width, int height, Position a, Position b);
+void trajectory_bin_write(TrajectoryBin *bin, const char *data, size_t len);
+_Bool trajectory_bin_close(TrajectoryBin *bin);
+// Subor, ktoremu po pade chyba index, sa skrati na length bajtov a index
+// sa postavi znova prechodom cez zaznamy; tych musi byt presne runs. Ak
+// subor nesedi, vrati 0 a nic nezmeni.
+_Bool trajectory_bin_recover(const char *path, uint64_t length, uint64_t runs);
+
+typedef struct {
+  FILE *f;
+  TrajectoryBinHeader header;
+  uint64_t *obstacle;
+  uint64_t runs;
+  uint64_t index_offset;
+} TrajectoryReader;
+
+_Bool trajectory_reader_open(TrajectoryReader *reader, const char *path);
+void trajectory_reader_close(TrajectoryReader *reader);
+_Bool trajectory_reader_record(TrajectoryReader *reader, uint64_t n, TrajectoryBinRecord *rec);
+// prehra beh N do sinku rovnako, ako ho zapisoval walker
+_Bool trajectory_reader_replay(TrajectoryReader *reader, uint64_t n, TrajectorySink *sink);
+
+#endif
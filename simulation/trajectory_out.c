@@ -0,0 +1,155 @@
+#include "trajectory_out.h"
+#include <stdlib.h>
+#include <string.h>
+
+static void output_write_text(void *ctx, const char *data, size_t len) {
+  trajectory_writer_write(&((TrajectoryOutput*)ctx)->writer, data, len);
+}
+
+static void output_write_bin(void *ctx, const char *data, size_t len) {
+  trajectory_bin_write(&((TrajectoryOutput*)ctx)->bin, data, len);
+}
+
+static _Bool output_sync_text(void *ctx, uint64_t *offset, uint64_t *records) {
+  *records = 0;
+  return trajectory_writer_sync(&((TrajectoryOutput*)ctx)->writer, offset);
+}
+
+static _Bool output_sync_bin(void *ctx, uint64_t *offset, uint64_t *records) {
+  TrajectoryBin *bin = &((TrajectoryOutput*)ctx)->bin;
+  *records = bin->runs;
+  // pocet zaznamov bez chybajucej polozky indexu by checkpoint nezodpovedal
+  return !bin->failed && trajectory_writer_sync(&bin->writer, offset);
+}
+
+TrajectoryOutput *trajectory_output_open(const char *path, const World *world, const SimulationConfig *config) {
+  TrajectoryOutput *out = malloc(sizeof(TrajectoryOutput));
+  if (!out) return NULL;
+
+  out->binary = trajectory_bin_path(path);
+  out->failed = 0;
+  out->width = world->width;
+  out->height = world->height;
+  _Bool ok = out->binary ? trajectory_bin_open(&out->bin, path, world, config)
+                         : trajectory_writer_open(&out->writer, path);
+  if (!ok) {
+    free(out);
+    return NULL;
+  }
+
+  if (out->binary) {
+    trajectory_queue_start(&out->queue, output_write_bin, output_sync_bin, out);
+  } else {
+    trajectory_queue_start(&out->queue, output_write_text, output_sync_text, out);
+  }
+  return out;
+}
+
+_Bool trajectory_output_format(const TrajectoryOutput *out, TrajectoryText *text, const TrajectoryBuffer *traj) {
+  if (out->binary) {
+    return trajectory_bin_run(text, traj, out->width, out->height);
+  }
+  return trajectory_text_run(text, traj);
+}
+
+void trajectory_output_push(TrajectoryOutput *out, TrajectoryText *text) {
+  if (out->failed) {
+    text->len = 0;
+    return;
+  }
+  trajectory_queue_push(&out->queue, text);
+}
+
+void trajectory_output_fail(TrajectoryOutput *out) {
+  out->failed = 1;
+}
+
+void trajectory_output_mark(TrajectoryOutput *out) {
+  trajectory_queue_mark(&out->queue);
+}
+
+_Bool trajectory_output_synced(TrajectoryOutput *out, uint64_t *offset, uint64_t *runs) {
+  return trajectory_queue_synced(&out->queue, offset, runs);
+}
+
+_Bool trajectory_output_close(TrajectoryOutput *out) {
+  if (!out) return 1;
+  trajectory_queue_stop(&out->queue);
+  _Bool ok = out->binary ? trajectory_bin_close(&out->bin) : trajectory_writer_close(&out->writer);
+  ok = ok && !out->failed;
+  free(out);
+  return ok;
+}
+
+static void stream_begin(TrajectorySink *sink, int run_no) {
+  TrajectoryStream *s = (TrajectoryStream*)sink;
+  s->run_no = run_no;
+  s->started = 0;
+  s->moves = 0;
+  s->packed = 0;
+  if (!s->out->binary && !trajectory_text_header(s->text, run_no, s->steps, s->success)) s->failed = 1;
+}
+
+static void stream_byte(TrajectoryStream *s) {
+  if (!trajectory_text_reserve(s->text, 1)) {
+    s->failed = 1;
+    return;
+  }
+  s->text->data[s->text->len++] = (char)s->packed;
+  s->packed = 0;
+}
+
+static void stream_pos(TrajectorySink *sink, Position pos) {
+  TrajectoryStream *s = (TrajectoryStream*)sink;
+  if (s->failed) return;
+
+  if (!s->out->binary) {
+    if (!trajectory_text_pos(s->text, pos)) s->failed = 1;
+  } else if (!s->started) {
+    // binarna hlavicka potrebuje start, teda prvu poziciu
+    if (!trajectory_bin_header(s->text, s->run_no, pos, s->steps, s->success)) s->failed = 1;
+  } else {
+    s->packed |= trajectory_bin_move(s->out->width, s->out->height, s->prev, pos) << (2 * (s->moves & 3));
+    if ((++s->moves & 3) == 0) stream_byte(s);
+  }
+  s->started = 1;
+  s->prev = pos;
+
+  // hlavicka je vzdy cela v prvej odovzdanej casti (trajectory_bin_write)
+  if (!s->failed && s->text->len >= s->limit && !s->flush(s->ctx)) s->failed = 1;
+}
+
+static void stream_end(TrajectorySink *sink, int steps, _Bool success) {
+  TrajectoryStream *s = (TrajectoryStream*)sink;
+  if (s->failed) return;
+  // ocakavany vysledok musi sediet, inak by hlavicka klamala
+  if (steps != s->steps || success != s->success || !s->started) {
+    s->failed = 1;
+    return;
+  }
+  if (!s->out->binary) {
+    if (!trajectory_text_end(s->text)) s->failed = 1;
+  } else if (s->moves != steps) {
+    s->failed = 1;
+  } else if (s->moves & 3) {
+    stream_byte(s);
+  }
+}
+
+void trajectory_stream_init(TrajectoryStream *stream, const TrajectoryOutput *out, TrajectoryText *text,
+                            size_t limit, _Bool (*flush)(void *ctx), void *ctx) {
+  memset(stream, 0, sizeof(*stream));
+  stream->sink.begin = stream_begin;
+  stream->sink.pos = stream_pos;
+  stream->sink.end = stream_end;
+  stream->out = out;
+  stream->text = text;
+  stream->limit = limit;
+  stream->flush = flush;
+  stream->ctx = ctx;
+}
+
+void trajectory_stream_expect(TrajectoryStream *stream, int steps, _Bool success) {
+  stream->steps = steps;
+  stream->success = success;
+}
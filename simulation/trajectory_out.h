@@ -0,0 +1,60 @@
+#ifndef TRAJECTORY_OUT_H
+#define TRAJECTORY_OUT_H
+
+#include "trajectory_bin.h"
+
+// Vystupny subor simulacie. Format sa vyberie podla pripony, zapis
+// na disk robi vlakno fronty, simulacne vlakna len odovzdavaju bloky.
+typedef struct {
+  _Bool binary;
+  int width;
+  int height;
+  TrajectoryWriter writer;
+  TrajectoryBin bin;
+  TrajectoryQueue queue;
+  // nejaky beh sa nepodarilo naformatovat, subor nie je uplny
+  _Bool failed;
+} TrajectoryOutput;
+
+// Beh formatovany priamo do text po poziciach, bez bufferu celeho behu.
+// Hlavicka oboch formatov ide pred pozicie, steps a success preto musia
+// byt zname uz pred begin (trajectory_stream_expect). Ked text prekroci
+// limit, zavola sa flush, ktory hotovu cast odovzda dalej a text vyprazdni;
+// pamat teda nezavisi od K. Chyba sa zapamata vo failed.
+typedef struct {
+  TrajectorySink sink;
+  const TrajectoryOutput *out;
+  TrajectoryText *text;
+  size_t limit;
+  _Bool (*flush)(void *ctx);
+  void *ctx;
+  int run_no;
+  int steps;
+  _Bool success;
+  _Bool started;
+  int32_t moves;
+  unsigned packed;
+  Position prev;
+  _Bool failed;
+} TrajectoryStream;
+
+TrajectoryOutput *trajectory_output_open(const char *path, const World *world, const SimulationConfig *config);
+// prida beh z bufferu do text vo formate vystupu
+_Bool trajectory_output_format(const TrajectoryOutput *out, TrajectoryText *text, const TrajectoryBuffer *traj);
+void trajectory_output_push(TrajectoryOutput *out, TrajectoryText *text);
+// vystup nie je uplny; dalsie bloky sa zahodia a close vrati 0 (vola producent)
+void trajectory_output_fail(TrajectoryOutput *out);
+// znacka pre checkpoint za posledny odovzdany beh a cakanie, kym je subor
+// po nu na disku; runs je pocet zaznamov .traj (pri texte 0)
+void trajectory_output_mark(TrajectoryOutput *out);
+_Bool trajectory_output_synced(TrajectoryOutput *out, uint64_t *offset, uint64_t *runs);
+// dopise frontu, pri .traj zapise index a zavrie subor; 0 pri chybe zapisu
+// alebo ak bol vystup oznaceny ako neuplny
+_Bool trajectory_output_close(TrajectoryOutput *out);
+
+void trajectory_stream_init(TrajectoryStream *stream, const TrajectoryOutput *out, TrajectoryText *text,
+                            size_t limit, _Bool (*flush)(void *ctx), void *ctx);
+// vysledok nasledujuceho behu, vola sa pred jeho begin
+void trajectory_stream_expect(TrajectoryStream *stream, int steps, _Bool success);
+
+#endif
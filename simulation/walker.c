@@ -13,6 +13,14 @@ Walker* walker_create(Position start ,MoveProbabilities probs) {
   walker->steps_made = 0;
   walker->num_of_sim = 0;
   walker->succ_sim = 0;
+  rng_seed(&walker->rng, RNG_XOSHIRO256, 0, 0);
+
+  // prahy sa rataju raz tu, v kroku uz nie je ziadna praca s double
+  uint64_t counts[4];
+  move_counts(probs, counts);
+  move_choice(counts, 15, walker->threshold, walker->dir);
+  walker->moves = NULL;
+  walker->prune = 0;
   return walker;
 }
 
@@ -20,46 +28,40 @@ void walker_destroy(Walker *walker) {
   free(walker);
 }
 
-_Bool walker_move(Walker *walker, World *world) {
-  MoveProbabilities probs = walker->probs;
-  
+// s tabulkou je krok vzdy uspesny, 0 vrati len ak sa z bunky neda pohnut
+static _Bool walker_step_table(Walker *walker, const World *world) {
+  const MoveTable *moves = walker->moves;
+  unsigned mask = moves->mask[world_cell_index(world, walker->pos.x, walker->pos.y)];
 
-  if(walker->at_finish) {
-    return 1;
-  }
- 
-  int r = rand() % 100;
-  Position newPosition = walker->pos;
-  
-  if(r<probs.down) {
-    newPosition.y +=1;
-  } else if (r < probs.down + probs.up) {
-    newPosition.y -=1;
-  } else if (r < probs.left + probs.down + probs.up) {
-    newPosition.x -= 1;
-  } else {
-    newPosition.x += 1;
+  if (move_table_stuck(moves, mask)) {
+    return 0;
   }
-    
-  if(newPosition.x >= world->width) {
-    newPosition.x %= world->width;
-  }
-  if (newPosition.y >= world->height) {
-    newPosition.y %= world->height;
+
+  int dir = move_table_pick(moves, mask, rng_next_u32(&walker->rng));
+  walker->pos = move_apply(world->width, world->height, walker->pos, dir);
+  walker->steps_made++;
+
+  if(walker->pos.x == 0 && walker->pos.y == 0) {
+    walker->at_finish = 1;
   }
-  
-  if (newPosition.x < 0) {
-    newPosition.x = world->width - 1;
+  return 1;
+}
+
+// jeden krok bez zapisu do world->visited, aby ho mohli volat paralelne workery
+_Bool walker_step(Walker *walker, const World *world) {
+  if(walker->at_finish) {
+    return 1;
   }
-  if (newPosition.y < 0) {
-    newPosition.y = world->height - 1;
+
+  if (walker->moves) {
+    return walker_step_table(walker, world);
   }
 
+  // bez tabulky sa smer vyberie zo vsetkych styroch, pohyb do prekazky krok nezapocita
+  int dir = move_pick(walker->threshold, walker->dir, rng_next_u32(&walker->rng));
+  Position newPosition = move_apply(world->width, world->height, walker->pos, dir);
 
-  if(world_is_valid_position(world, newPosition) && !world->obstacle[newPosition.y][newPosition.x]) {
-    if ((walker->pos.x > 0 && walker->pos.x < 50) || (walker->pos.y > 0 && walker->pos.y < 50)){
-      world->visited[walker->pos.y][walker->pos.x] = 1;
-    }
+  if(world_is_valid_position(world, newPosition) && !world_obstacle_at(world, newPosition.x, newPosition.y)) {
     walker->pos = newPosition;
     walker->steps_made++;
 
@@ -71,6 +73,19 @@ _Bool walker_move(Walker *walker, World *world) {
   return 0;
 }
 
+_Bool walker_move(Walker *walker, World *world) {
+  if(walker->at_finish) {
+    return 1;
+  }
+
+  Position old = walker->pos;
+  if (!walker_step(walker, world)) {
+    return 0;
+  }
+  world_mark_visited(world, old.x, old.y);
+  return 1;
+}
+
 void walker_reset(Walker *walker, Position start) {
   walker->at_finish = 0;
   walker->pos = start;
@@ -90,58 +105,40 @@ int walker_get_steps(const Walker *walker) {
   return walker->steps_made;
 }
 
-Trajectory * trajectory_create(int max_length) {
-  Trajectory * trajectory = malloc(sizeof(Trajectory));
-  if (!trajectory) return NULL;
-  
-  trajectory->pos = malloc(max_length * sizeof(Position));
-  if (!trajectory->pos) {
-    free(trajectory);
-    return NULL;
-  }
-
-  trajectory->capacity = max_length;
-  trajectory->steps_made = 0;
-  trajectory->length = 0;
-  trajectory->finished = 0;
-
-  return trajectory;
-}
-
-void trajectory_destroy(Trajectory *traj) {
-  if (!traj) return;
-  free(traj->pos);
-  free(traj);
-}
-
-void trajectory_add_pos(Trajectory *traj, Position pos) {
-  traj->pos[traj->length] = pos;
-  traj->length++;
-}
-
-Trajectory * walker_simulate_to_center(Walker * walker , World * world , int max_steps) {
-  Trajectory * trajectory = trajectory_create(max_steps);
-  trajectory_add_pos(trajectory, walker->start_pos);
+// pozicie idu priamo do sinku, beh sam nic nealokuje
+_Bool walker_simulate_to_center(Walker * walker , World * world , int max_steps, TrajectorySink * sink) {
+  if (sink) sink->pos(sink, walker->start_pos);
 
   if (walker->pos.x ==0 && walker->pos.y == 0) {
-    trajectory->finished = 1;
     walker->succ_sim++;
     walker->at_finish =1;
-    return trajectory;
+    return 1;
+  }
+  // Neuspech je isty, ked zvysok krokov nestaci na vzdialenost do ciela.
+  // Walker by potom dokrokoval do max_steps (bez nulovych pravdepodobnosti
+  // sa po prvom kroku uz nezasekne), takze sa kroky len dopocitaju.
+  if (!sink && walker->prune && walker->moves && world->dist) {
+    int late = max_steps - world->dist_max;
+    while (!walker->at_finish && walker->steps_made < max_steps) {
+      if (!walker_step_table(walker, world)) break;
+      if (walker->steps_made > late &&
+          walker->steps_made + world->dist[world_cell_index(world, walker->pos.x, walker->pos.y)] > max_steps) {
+        walker->steps_made = max_steps;
+        break;
+      }
+    }
   }
   while (!walker->at_finish && walker->steps_made < max_steps) {
-      if(walker_move(walker , world)){
-      trajectory_add_pos(trajectory, walker->pos);
+      if(walker_step(walker , world)){
+      if (sink) sink->pos(sink, walker->pos);
+    } else if (walker->moves) {
+      break;
     }
   }
   if (walker->at_finish) {
-    trajectory->finished = 1;
     walker->succ_sim++;
   }
-
-  trajectory->steps_made = walker->steps_made;
   walker->num_of_sim++;
 
-  return trajectory;
-
-} 
+  return walker->at_finish;
+}
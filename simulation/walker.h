@@ -2,6 +2,9 @@
 #define WALKER_H
 
 #include "world.h"
+#include "rng.h"
+#include "move_table.h"
+#include "trajectory.h"
 
 
 typedef struct {
@@ -12,29 +15,21 @@ typedef struct {
   _Bool at_finish;
   int num_of_sim;
   int succ_sim;
+  Rng rng;
+  uint32_t threshold[3];
+  uint8_t dir[4];
+  const MoveTable* moves;
+  // beh bez sinku skonci, ked uz do ciela nestihne dojst (world->dist)
+  _Bool prune;
 } Walker ;
 
-typedef struct {
-  Position* pos;
-  int capacity;
-  int length;
-  _Bool finished;
-  int steps_made;
-}Trajectory ;
-
-
-  
-Trajectory* trajectory_create(int max_length);
-void trajectory_destroy(Trajectory* traj);
-void trajectory_add_pos(Trajectory* traj , Position pos );
-
-
 Walker* walker_create(Position start, MoveProbabilities probs);
 void walker_destroy(Walker* walker);
 _Bool walker_move(Walker* walker, World* world);
+_Bool walker_step(Walker* walker, const World* world);
 void walker_reset(Walker* walker, Position start);
 _Bool walker_has_reached_center(const Walker* walker);
 Position walker_get_position(const Walker* walker);
 int walker_get_steps(const Walker* walker);
-Trajectory* walker_simulate_to_center(Walker* walker, World* world, int max_steps);
+_Bool walker_simulate_to_center(Walker* walker, World* world, int max_steps, TrajectorySink* sink);
 #endif 
@@ -1,169 +1,530 @@
 #include "world.h"
 #include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 World* world_create(int width , int height) {
+  if (width <= 0 || height <= 0) {
+    return NULL;
+  }
+
   World * world = malloc(sizeof(World));
+  if (!world) {
+    return NULL;
+  }
 
   world->height = height;
   world->width = width;
-
-  world->obstacle = malloc(height * sizeof(_Bool*));
-
-  world->visited = malloc(height * sizeof(_Bool*)); 
-
-  for (int i = 0; i < height; i++) {
-    world->obstacle[i] = calloc(width, sizeof(_Bool));
-    world->visited[i] = calloc(width , sizeof(_Bool));
-  }   
+  world->stride = (width + 63) / 64;
+
+  // jedna alokacia pre obe mapy: najprv bity prekazok, potom visited
+  size_t words = (size_t)world->stride * (size_t)height;
+  size_t cells = (size_t)width * (size_t)height;
+  world->obstacle = calloc(words * sizeof(uint64_t) + cells, 1);
+  if (!world->obstacle) {
+    free(world);
+    return NULL;
+  }
+  world->visited = (unsigned char*)(world->obstacle + words);
+  world->visited_count = 0;
+  world->map = NULL;
+  world->map_len = 0;
+  world->reach = NULL;
+  world->dist = NULL;
+  world->dist_max = 0;
 
   return world;
 }
-void world_destroy(World *world) {
-  
-  for (int i  = 0; i < world->height; i++) {
+// po zmene prekazok sa indexy cesty do ciela postavia znova
+static void world_index_drop(World *world) {
+  free(world->reach);
+  free(world->dist);
+  world->reach = NULL;
+  world->dist = NULL;
+  world->dist_max = 0;
+}
 
-    free(world->obstacle[i]);
-    free(world->visited[i]);
+void world_destroy(World *world) {
+  if (!world) return;
+  world_index_drop(world);
+  if (world->map) {
+    munmap(world->map, world->map_len);
+    free(world->visited);
+  } else {
+    free(world->obstacle);
   }
-  
-  free(world->obstacle);
-  free(world->visited);
   free(world);
 }
-_Bool world_is_valid_position(World *world, Position pos) {
-  if (pos.x < 0|| pos.y < 0 || pos.x > 50 || pos.y > 50) {
+_Bool world_is_valid_position(const World *world, Position pos) {
+  if (pos.x < 0|| pos.y < 0 || pos.x >= world->width || pos.y >= world->height) {
     return 0;
   }
   return 1;
 }
 _Bool world_add_obstacle(World *world, Position pos) {
-  if (world_is_valid_position(world, pos) && world->obstacle[pos.y][pos.x] == 0) {
-    world->obstacle[pos.y][pos.x] = 1;
+  // prekazky zo suboru su zdielane a len na citanie
+  if (world->map) return 0;
+  if (world_is_valid_position(world, pos) && !world_obstacle_at(world, pos.x, pos.y)) {
+    world_set_obstacle(world, pos.x, pos.y, 1);
+    world_index_drop(world);
     return 1;
   }
   return 0;
  
 }
 _Bool world_remove_obstacle(World *world, Position pos) {
-  if (world_is_valid_position(world,pos) && world->obstacle[pos.y][pos.x]==1) {
-    world->obstacle[pos.y][pos.x] = 0;
+  if (world->map) return 0;
+  if (world_is_valid_position(world,pos) && world_obstacle_at(world, pos.x, pos.y)) {
+    world_set_obstacle(world, pos.x, pos.y, 0);
+    world_index_drop(world);
     return 1;
   }
   return 0;
 }
 
-_Bool world_is_accessible(World *world, Position to) {
-  if (world_is_valid_position(world, to) && world->obstacle[to.y][to.x]==0 ) {
+_Bool world_is_accessible(const World *world, Position to) {
+  if (world_is_valid_position(world, to) && !world_obstacle_at(world, to.x, to.y)) {
     return 1;
   } else {
     return 0;
   }
 }
 
-World* world_generate_random(int width , int height , double obstacle_ratio , Position startPos){
+static size_t obstacle_count(size_t cells, double obstacle_ratio, size_t free_cells) {
+  if (obstacle_ratio >= 1) {
+    obstacle_ratio /= 100;
+  }
+  if (obstacle_ratio <= 0) {
+    return 0;
+  }
+  size_t n = (size_t)((double)cells * obstacle_ratio);
+  return n > free_cells ? free_cells : n;
+}
+
+static int cmp_size(const void *a, const void *b) {
+  size_t x = *(const size_t*)a;
+  size_t y = *(const size_t*)b;
+  return (x > y) - (x < y);
+}
+
+static void set_cell(World *world, size_t cell) {
+  world_set_obstacle(world, (int)(cell % (size_t)world->width), (int)(cell / (size_t)world->width), 1);
+}
+
+static _Bool cell_taken(const World *world, size_t cell) {
+  return world_obstacle_at(world, (int)(cell % (size_t)world->width), (int)(cell / (size_t)world->width));
+}
+
+// Floydov vyber k roznych policok mimo skip (vzostupne zoradene indexy):
+// kazdy krok je jeden nahodny vyber bez opakovania, takze cas je O(k) pri
+// akejkolvek hustote. Vybera sa z indexov [0, n), n = cells - nskip;
+// policka zo skip pod n (oznacene vo visited) sa nahradia volnymi polickami
+// z [n, cells). Obsadenost sa kontroluje priamo v bitovej mape prekazok.
+static _Bool place_obstacles(World *world, size_t k, const size_t *skip, size_t nskip, Rng *rng) {
+  size_t cells = (size_t)world->width * (size_t)world->height;
+  size_t n = cells - nskip;
+  size_t *repl = malloc((nskip ? nskip : 1) * sizeof(size_t));
+  if (!repl) return 0;
+
+  size_t low = 0;
+  for (size_t i = 0; i < nskip; i++) {
+    world->visited[skip[i]] = 1;
+    if (skip[i] < n) low++;
+  }
+  size_t next = n;
+  for (size_t i = 0; i < low; i++) {
+    while (world->visited[next]) next++;
+    repl[i] = next++;
+  }
+
+  for (size_t j = n - k; j < n; j++) {
+    size_t cell = (size_t)rng_bounded64(rng, (uint64_t)j + 1);
+    if (world->visited[cell]) {
+      cell = repl[(const size_t*)bsearch(&cell, skip, low, sizeof(size_t), cmp_size) - skip];
+    }
+    if (cell_taken(world, cell)) {
+      cell = j;
+      if (world->visited[cell]) {
+        cell = repl[(const size_t*)bsearch(&cell, skip, low, sizeof(size_t), cmp_size) - skip];
+      }
+    }
+    set_cell(world, cell);
+  }
+
+  for (size_t i = 0; i < nskip; i++) {
+    world->visited[skip[i]] = 0;
+  }
+  free(repl);
+  return 1;
+}
+
+World* world_generate_random(int width , int height , double obstacle_ratio , Position startPos, Rng *rng){
   World *world = world_create(width, height);
   if (!world) {
     return NULL;
   }
+  if (!world_is_valid_position(world, startPos)) {
+    world_destroy(world);
+    return NULL;
+  }
 
-  if (obstacle_ratio >= 1) {
-    obstacle_ratio /=100;
+  size_t cells = (size_t)width * (size_t)height;
+  size_t start = world_cell_index(world, startPos.x, startPos.y);
+  if (!place_obstacles(world, obstacle_count(cells, obstacle_ratio, cells - 1), &start, 1, rng)) {
+    world_destroy(world);
+    return NULL;
   }
-  
-  int num_of_obstacle = (width * height) * obstacle_ratio;
-  Position pos;
+  return world;
+}
 
-  int index = 0;
-  while ( index < num_of_obstacle) {
-    pos.x = rand() % width;
-    pos.y = rand() % height;
+// kratsi smer na toruse z a do b: vrati pocet krokov, do *dir da +1 alebo -1
+static int torus_steps(int a, int b, int size, int *dir) {
+  int forward = ((b - a) % size + size) % size;
+  if (forward <= size - forward) {
+    *dir = 1;
+    return forward;
+  }
+  *dir = -1;
+  return size - forward;
+}
 
-    if ((pos.x != startPos.x || pos.y != startPos.y) && world_add_obstacle(world, pos)) {
-      index++;
+// Najprv sa vyhradi nahodna najkratsia cesta zo startu do (0,0), potom sa
+// prekazky kladu len mimo nej, takze cesta existuje vzdy a staci jeden
+// priechod.
+World* world_generate_connected(int width, int height, double obstacle_ratio, Position startPos, Rng *rng) {
+  World *world = world_create(width, height);
+  if (!world) {
+    return NULL;
+  }
+  if (!world_is_valid_position(world, startPos)) {
+    world_destroy(world);
+    return NULL;
+  }
+
+  int dir_x, dir_y;
+  int left_x = torus_steps(startPos.x, 0, width, &dir_x);
+  int left_y = torus_steps(startPos.y, 0, height, &dir_y);
+  size_t *path = malloc(((size_t)left_x + (size_t)left_y + 1) * sizeof(size_t));
+  if (!path) {
+    world_destroy(world);
+    return NULL;
+  }
+
+  Position pos = startPos;
+  size_t reserved = 0;
+  path[reserved++] = world_cell_index(world, pos.x, pos.y);
+  while (left_x + left_y > 0) {
+    if (rng_bounded(rng, (uint32_t)(left_x + left_y)) < (uint32_t)left_x) {
+      pos.x = (pos.x + dir_x + width) % width;
+      left_x--;
+    } else {
+      pos.y = (pos.y + dir_y + height) % height;
+      left_y--;
     }
+    path[reserved++] = world_cell_index(world, pos.x, pos.y);
   }
+  qsort(path, reserved, sizeof(size_t), cmp_size);
 
+  size_t cells = (size_t)width * (size_t)height;
+  _Bool ok = place_obstacles(world, obstacle_count(cells, obstacle_ratio, cells - reserved), path, reserved, rng);
+  free(path);
+  if (!ok) {
+    world_destroy(world);
+    return NULL;
+  }
   return world;
 }
 
 void reset_visited(World * world){
-  for (int i = 0; i < world->height; i++) {
-    for (int j = 0; j < world->width; j++) {
-      world->visited[i][j] = 0;
-    }
-  }
+  memset(world->visited, 0, (size_t)world->width * (size_t)world->height);
+  world->visited_count = 0;
 }
 
 void reset_obstacles(World * world) {
-  for (int i = 0; i < world->height; i++) {
-    for (int j = 0; j < world->width; j++) {
-      world->obstacle[i][j] = 0;
-    }
-  }
+  if (world->map) return;
+  world_index_drop(world);
+  memset(world->obstacle, 0, (size_t)world->stride * (size_t)world->height * sizeof(uint64_t));
 }
 
+// Zapis do docasneho suboru a rename, aby procesy, ktore maju stary subor
+// namapovany, videli stale celu povodnu verziu.
+_Bool world_save_to_file(const World *world, const char *filename) {
+  size_t words = (size_t)world->stride * (size_t)world->height;
+  size_t len = strlen(filename);
+  char *tmp = malloc(len + 5);
+  if (!tmp) return 0;
+  memcpy(tmp, filename, len);
+  memcpy(tmp + len, ".tmp", 5);
+
+  FILE *f = fopen(tmp, "wb");
+  if (!f) {
+    free(tmp);
+    return 0;
+  }
 
-//Funkcia vygenerovana AI
-_Bool world_has_path(World *world, Position start) {
-    // Ak začíname v cieli, cesta existuje hneď
-    if (start.x == 0 && start.y == 0) return 1;
+  unsigned char header[WORLD_FILE_HEADER] = {0};
+  WorldFileHeader h;
+  memset(&h, 0, sizeof(h));
+  memcpy(h.magic, WORLD_FILE_MAGIC, 4);
+  h.version = WORLD_FILE_VERSION;
+  h.width = world->width;
+  h.height = world->height;
+  h.stride = world->stride;
+  h.header_size = WORLD_FILE_HEADER;
+  h.obstacle_words = words;
+  memcpy(header, &h, sizeof(h));
+
+  _Bool ok = fwrite(header, sizeof(header), 1, f) == 1 &&
+             fwrite(world->obstacle, sizeof(uint64_t), words, f) == words;
+  ok = (fclose(f) == 0) && ok;
+  if (ok) ok = rename(tmp, filename) == 0;
+  if (!ok) remove(tmp);
+  free(tmp);
+  return ok;
+}
 
-    // 1. Alokácia dočasnej mapy navštívených políčok
-    _Bool **visited_tmp = malloc(world->height * sizeof(_Bool*));
-    for (int i = 0; i < world->height; i++) {
-        visited_tmp[i] = calloc(world->width, sizeof(_Bool));
+uint64_t world_hash(const World *world) {
+  uint64_t h = 0xcbf29ce484222325ULL;
+  uint64_t dims[2] = {(uint64_t)world->width, (uint64_t)world->height};
+  size_t words = (size_t)world->stride * (size_t)world->height;
+  for (size_t i = 0; i < 2 + words; i++) {
+    uint64_t w = i < 2 ? dims[i] : world->obstacle[i - 2];
+    for (int b = 0; b < 64; b += 8) {
+      h ^= (w >> b) & 0xff;
+      h *= 0x100000001b3ULL;
     }
+  }
+  return h;
+}
 
-    // 2. Príprava fronty 
-    Position *queue = malloc(world->width * world->height * sizeof(Position));
-    int head = 0, tail = 0;
+// Prekazky sa nekopiruju, World ukazuje priamo do mmap-u suboru. Viac
+// procesov s tym istym suborom tak zdiela jednu kopiu v page cache.
+World* world_load_from_file(const char *filename) {
+  int fd = open(filename, O_RDONLY);
+  if (fd < 0) return NULL;
 
-    // Vložíme štartovaciu pozíciu
-    queue[tail++] = start;
-    visited_tmp[start.y][start.x] = 1;
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size < WORLD_FILE_HEADER) {
+    close(fd);
+    return NULL;
+  }
+  size_t map_len = (size_t)st.st_size;
+  void *map = mmap(NULL, map_len, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) return NULL;
+
+  WorldFileHeader h;
+  memcpy(&h, map, sizeof(h));
+  _Bool ok = memcmp(h.magic, WORLD_FILE_MAGIC, 4) == 0 && h.version == WORLD_FILE_VERSION &&
+             h.width > 0 && h.height > 0 && h.stride == (h.width + 63) / 64 &&
+             h.header_size >= sizeof(h) && h.header_size % sizeof(uint64_t) == 0 &&
+             h.obstacle_words == (uint64_t)h.stride * (uint64_t)h.height &&
+             h.header_size + h.obstacle_words * sizeof(uint64_t) <= map_len;
+
+  World *world = ok ? malloc(sizeof(World)) : NULL;
+  size_t cells = (size_t)h.width * (size_t)h.height;
+  unsigned char *visited = world ? calloc(cells, 1) : NULL;
+  if (!visited) {
+    free(world);
+    munmap(map, map_len);
+    return NULL;
+  }
 
-    // Smery pohybu: hore, dole, vľavo, vpravo
-    const int dx[] = {0, 0, -1, 1};
-    const int dy[] = {-1, 1, 0, 0};
+  world->width = h.width;
+  world->height = h.height;
+  world->stride = h.stride;
+  world->obstacle = (uint64_t*)((char*)map + h.header_size);
+  world->visited = visited;
+  world->visited_count = 0;
+  world->map = map;
+  world->map_len = map_len;
+  world->reach = NULL;
+  world->dist = NULL;
+  world->dist_max = 0;
+
+  // bity za koncom riadku su v kazdom svete z world_create nulove, subor tiez
+  if (h.width % 64 != 0) {
+    uint64_t tail = ~(((uint64_t)1 << (h.width % 64)) - 1);
+    for (int y = 0; y < h.height; y++) {
+      if (world->obstacle[(size_t)y * h.stride + h.stride - 1] & tail) {
+        world_destroy(world);
+        return NULL;
+      }
+    }
+  }
+  return world;
+}
 
-    _Bool found = 0;
+// sused cez okraj torusu, rovnako ako move_apply
+static Position move_step(const World *world, Position pos, int dir) {
+  switch (dir) {
+    case 0: pos.y = (pos.y + 1 == world->height) ? 0 : pos.y + 1; break;
+    case 1: pos.y = (pos.y == 0) ? world->height - 1 : pos.y - 1; break;
+    case 2: pos.x = (pos.x == 0) ? world->width - 1 : pos.x - 1; break;
+    default: pos.x = (pos.x + 1 == world->width) ? 0 : pos.x + 1; break;
+  }
+  return pos;
+}
 
-    // 3. Hlavný cyklus 
-    while (head < tail) {
-        Position curr = queue[head++];
+// Kogge-Stone vyplnenie: g sa v 6 krokoch rozleje po volnych bitoch p smerom
+// k vyssim (fill_up) alebo nizsim (fill_down) bitom.
+static inline uint64_t fill_up(uint64_t g, uint64_t p) {
+  g |= p & (g << 1);  p &= p << 1;
+  g |= p & (g << 2);  p &= p << 2;
+  g |= p & (g << 4);  p &= p << 4;
+  g |= p & (g << 8);  p &= p << 8;
+  g |= p & (g << 16); p &= p << 16;
+  return g | (p & (g << 32));
+}
 
-        // Skontrolujeme, či sme v cieli [0,0]
-        if (curr.x == 0 && curr.y == 0) {
-            found = 1;
-            break;
-        }
+static inline uint64_t fill_down(uint64_t g, uint64_t p) {
+  g |= p & (g >> 1);  p &= p >> 1;
+  g |= p & (g >> 2);  p &= p >> 2;
+  g |= p & (g >> 4);  p &= p >> 4;
+  g |= p & (g >> 8);  p &= p >> 8;
+  g |= p & (g >> 16); p &= p >> 16;
+  return g | (p & (g >> 32));
+}
 
-        for (int i = 0; i < 4; i++) {
-            Position next = {curr.x + dx[i], curr.y + dy[i]};
+// volne bity slova i riadku; bity za sirkou su vzdy obsadene
+static inline uint64_t free_word(const World *world, const uint64_t *obstacle, int i) {
+  uint64_t f = ~obstacle[i];
+  if (i == world->stride - 1 && (world->width & 63)) {
+    f &= ((uint64_t)1 << (world->width & 63)) - 1;
+  }
+  return f;
+}
 
-            // PAC-MAN LOGIKA: Pretečenie cez okraje (ako v tvojom walker_move)
-            if (next.x >= world->width) next.x = 0;
-            else if (next.x < 0) next.x = world->width - 1;
+// rozleje r po volnych polickach riadku oboma smermi, prenos medzi slovami
+// a cez okraj torusu (x = width-1 <-> 0)
+static void row_fill(const World *world, uint64_t *r, const uint64_t *obstacle) {
+  int stride = world->stride;
+  int last = (world->width - 1) >> 6;
+  uint64_t top = (uint64_t)1 << ((world->width - 1) & 63);
+
+  while (1) {
+    uint64_t carry = 0;
+    for (int i = 0; i < stride; i++) {
+      uint64_t f = free_word(world, obstacle, i);
+      r[i] = fill_up(r[i] | (carry & f), f);
+      carry = r[i] >> 63;
+    }
+    carry = 0;
+    for (int i = stride - 1; i >= 0; i--) {
+      uint64_t f = free_word(world, obstacle, i);
+      r[i] = fill_down(r[i] | ((carry << 63) & f), f);
+      carry = r[i] & 1;
+    }
 
-            if (next.y >= world->height) next.y = 0;
-            else if (next.y < 0) next.y = world->height - 1;
+    _Bool wrap_left = (r[last] & top) && !(r[0] & 1) && (free_word(world, obstacle, 0) & 1);
+    _Bool wrap_right = (r[0] & 1) && !(r[last] & top) && (free_word(world, obstacle, last) & top);
+    if (wrap_left) r[0] |= 1;
+    if (wrap_right) r[last] |= top;
+    if (!wrap_left && !wrap_right) return;
+  }
+}
 
-            // Kontrola, či na novej pozícii nie je prekážka a či sme tam už neboli
-            if (!world->obstacle[next.y][next.x] && !visited_tmp[next.y][next.x]) {
-                visited_tmp[next.y][next.x] = 1;
-                queue[tail++] = next;
-            }
-        }
+// prida do riadku r polia zo susedneho riadku n a rozleje ich; vrati, ci sa
+// riadok zmenil
+static _Bool row_grow(const World *world, uint64_t *r, const uint64_t *n, const uint64_t *obstacle) {
+  _Bool changed = 0;
+  for (int i = 0; i < world->stride; i++) {
+    uint64_t add = n[i] & free_word(world, obstacle, i) & ~r[i];
+    if (add) {
+      r[i] |= add;
+      changed = 1;
     }
+  }
+  if (changed) row_fill(world, r, obstacle);
+  return changed;
+}
 
-    // 4. Uvoľnenie pamäte
-    for (int i = 0; i < world->height; i++) {
-        free(visited_tmp[i]);
+// Bitovy flood fill z ciela: 64 policok naraz v riadku, striedavo prechody
+// dole a hore, kym sa nic nezmeni. Graf je neorientovany, takze vysledok su
+// presne policka, z ktorych sa da do ciela dostat. Stavia sa raz na svet.
+_Bool world_reach_build(World *world) {
+  if (world->reach) return 1;
+
+  int stride = world->stride;
+  int height = world->height;
+  size_t words = (size_t)stride * (size_t)height;
+  uint64_t *reach = calloc(words, sizeof(uint64_t));
+  if (!reach) return 0;
+
+  if (!world_obstacle_at(world, 0, 0)) {
+    reach[0] = 1;
+    row_fill(world, reach, world->obstacle);
+
+    _Bool changed = 1;
+    while (changed) {
+      changed = 0;
+      for (int y = 0; y < height; y++) {
+        int prev = y == 0 ? height - 1 : y - 1;
+        changed |= row_grow(world, reach + (size_t)y * stride, reach + (size_t)prev * stride,
+                            world->obstacle + (size_t)y * stride);
+      }
+      for (int y = height - 1; y >= 0; y--) {
+        int next = y == height - 1 ? 0 : y + 1;
+        changed |= row_grow(world, reach + (size_t)y * stride, reach + (size_t)next * stride,
+                            world->obstacle + (size_t)y * stride);
+      }
     }
-    free(visited_tmp);
-    free(queue);
+  }
 
-    return found;
+  world->reach = reach;
+  return 1;
 }
 
+// BFS z ciela po vrstvach; policka mimo komponentu ciela maju WORLD_DIST_NONE.
+// Pole je o dva prvky dlhsie, aby 32-bitovy gather na poslednej bunke
+// necital za alokaciu.
+_Bool world_dist_build(World *world) {
+  if (world->dist) return 1;
+
+  size_t cells = (size_t)world->width * (size_t)world->height;
+  uint16_t *dist = malloc((cells + 2) * sizeof(uint16_t));
+  size_t *queue = malloc(cells * sizeof(size_t));
+  if (!dist || !queue) {
+    free(dist);
+    free(queue);
+    return 0;
+  }
+  memset(dist, 0xFF, (cells + 2) * sizeof(uint16_t));
+
+  size_t head = 0, tail = 0;
+  int dist_max = 0;
+  if (!world_obstacle_at(world, 0, 0)) {
+    dist[0] = 0;
+    queue[tail++] = 0;
+  }
+  while (head < tail) {
+    size_t cell = queue[head++];
+    Position curr = { (int)(cell % (size_t)world->width), (int)(cell / (size_t)world->width) };
+    int d = dist[cell] < WORLD_DIST_CAP ? dist[cell] + 1 : WORLD_DIST_CAP;
+    for (int dir = 0; dir < 4; dir++) {
+      Position next = move_step(world, curr, dir);
+      size_t idx = world_cell_index(world, next.x, next.y);
+      if (dist[idx] == WORLD_DIST_NONE && !world_obstacle_at(world, next.x, next.y)) {
+        dist[idx] = (uint16_t)d;
+        if (d > dist_max) dist_max = d;
+        queue[tail++] = idx;
+      }
+    }
+  }
+
+  free(queue);
+  world->dist = dist;
+  world->dist_max = dist_max;
+  return 1;
+}
 
+_Bool world_has_path(World *world, Position start) {
+  if (!world_is_accessible(world, start)) return 0;
+  if (start.x == 0 && start.y == 0) return 1;
+  if (!world_reach_build(world)) return 0;
+  return world_reaches_target(world, start.x, start.y);
+}
@@ -2,27 +2,100 @@
 #define WORLD_H
 
 #include "../common/types.h"  
+#include "rng.h"
 
+#include <stddef.h>
+
+// Prekazky su bitova mapa (riadok = stride 64-bitovych slov), visited je
+// bajtova mapa width*height hned za nou v tej istej alokacii. Svet nacitany
+// zo suboru ma prekazky priamo v mmap-e suboru (len na citanie) a visited
+// alokovane zvlast. reach je bitova mapa v tvare obstacle s polickami
+// komponentu, v ktorom je ciel (0,0); dist je najkratsia vzdialenost kazdeho
+// policka do ciela. Oba indexy su NULL, kym sa nepostavia.
 typedef struct {
   int width;
   int height;
-  _Bool** obstacle;
-  _Bool** visited;
+  int stride;
+  uint64_t* obstacle;
+  unsigned char* visited;
+  size_t visited_count;
+  void* map;
+  size_t map_len;
+  uint64_t* reach;
+  uint16_t* dist;
+  int dist_max;  // najvacsia vzdialenost v komponente ciela
 } World;
 
+// vzdialenosti nad WORLD_DIST_CAP sa ukladaju ako WORLD_DIST_CAP (dolny odhad)
+#define WORLD_DIST_CAP 0xFFFE
+#define WORLD_DIST_NONE 0xFFFF
+
+// Subor sveta: hlavicka WORLD_FILE_HEADER bajtov a za nou bitova mapa
+// prekazok presne v tvare World.obstacle (bity za sirkou riadku su 0).
+#define WORLD_FILE_MAGIC "WWLD"
+#define WORLD_FILE_VERSION 1
+#define WORLD_FILE_HEADER 64
+
+typedef struct {
+  char magic[4];
+  uint32_t version;
+  int32_t width;
+  int32_t height;
+  int32_t stride;
+  uint32_t header_size;
+  uint64_t obstacle_words;
+} WorldFileHeader;
+
+static inline size_t world_cell_index(const World* world, int x, int y) {
+  return (size_t)y * (size_t)world->width + (size_t)x;
+}
+
+static inline _Bool world_obstacle_at(const World* world, int x, int y) {
+  return (world->obstacle[(size_t)y * world->stride + ((unsigned)x >> 6)] >> (x & 63)) & 1;
+}
+
+static inline void world_set_obstacle(World* world, int x, int y, _Bool value) {
+  uint64_t* word = &world->obstacle[(size_t)y * world->stride + ((unsigned)x >> 6)];
+  uint64_t bit = (uint64_t)1 << (x & 63);
+  *word = value ? (*word | bit) : (*word & ~bit);
+}
+
+// platne len po world_reach_build
+static inline _Bool world_reaches_target(const World* world, int x, int y) {
+  return (world->reach[(size_t)y * world->stride + ((unsigned)x >> 6)] >> (x & 63)) & 1;
+}
+
+static inline _Bool world_visited_at(const World* world, int x, int y) {
+  return world->visited[world_cell_index(world, x, y)];
+}
+
+static inline void world_mark_visited(World* world, int x, int y) {
+  unsigned char* cell = &world->visited[world_cell_index(world, x, y)];
+  if (!*cell) {
+    *cell = 1;
+    world->visited_count++;
+  }
+}
+
 World* world_create(int width, int height);
 void world_destroy(World* world);
-_Bool world_is_valid_position(World* world, Position pos);
+_Bool world_is_valid_position(const World* world, Position pos);
 Position world_wrap_position(const World* world, Position pos);
 Position* world_get_neighbors(const World* world, Position pos, int* count);
 _Bool world_add_obstacle(World* world, Position pos);
 _Bool world_remove_obstacle(World* world, Position pos);
-_Bool world_is_accessible(World* world, Position to);
-_Bool world_load_from_file(World* world, const char* filename);
+_Bool world_is_accessible(const World* world, Position to);
+World* world_load_from_file(const char* filename);
 _Bool world_save_to_file(const World* world, const char* filename);
-World* world_generate_random(int width, int height, double obstacle_ratio , Position startPos);
+// FNV-1a cez rozmery a bitovu mapu prekazok, odtlacok sveta v checkpointe
+uint64_t world_hash(const World* world);
+World* world_generate_random(int width, int height, double obstacle_ratio , Position startPos, Rng *rng);
+// svet, v ktorom vzdy existuje cesta zo startPos do (0,0)
+World* world_generate_connected(int width, int height, double obstacle_ratio, Position startPos, Rng *rng);
 void reset_visited(World * world);
 void reset_obstacles(World * world);
+_Bool world_reach_build(World *world);
+_Bool world_dist_build(World *world);
 _Bool world_has_path(World *world, Position start);
 
 #endif 
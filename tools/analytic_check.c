@@ -0,0 +1,87 @@
+#include "../simulation/simulation.h"
+#include "../simulation/engine.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Porovnanie presnych hodnot z analytic.h s Monte Carlo na nahodnom svete.
+// Odchylka nad CHECK_Z_MAX standardnych chyb sa hlasi ako chyba.
+#define CHECK_Z_MAX 4.5
+
+static int check(const char *name, double exact, double mc, double se) {
+  double z = se > 0 ? (mc - exact) / se : (mc == exact ? 0 : INFINITY);
+  int ok = fabs(z) <= CHECK_Z_MAX;
+  printf("%-22s presne %12.4f  MC %12.4f +- %.4f  z %+6.2f  %s\n", name, exact, mc, se, z, ok ? "OK" : "CHYBA");
+  return ok;
+}
+
+int main(int argc, char **argv) {
+  if (argc < 8) {
+    fprintf(stderr, "Pouzitie: %s sirka vyska x y prekazky K behy [up down left right] [seed]\n", argv[0]);
+    return 2;
+  }
+
+  SimulationConfig config = {0};
+  config.width = atoi(argv[1]);
+  config.height = atoi(argv[2]);
+  config.x = atoi(argv[3]);
+  config.y = atoi(argv[4]);
+  config.obstacle_ratio = atof(argv[5]);
+  config.max_steps_K = atoi(argv[6]);
+  config.total_replications = atoi(argv[7]);
+  config.probs = (MoveProbabilities){0.25, 0.25, 0.25, 0.25};
+  if (argc >= 12) {
+    config.probs = (MoveProbabilities){atof(argv[8]), atof(argv[9]), atof(argv[10]), atof(argv[11])};
+  }
+  config.seed = argc >= 13 ? strtoull(argv[12], NULL, 10) : 1;
+  config.rng = RNG_XOSHIRO256;
+  config.mode = MODE_SUMMARY;
+  config.exact = 1;
+
+  Position start = {config.x, config.y};
+  Rng rng;
+  rng_seed(&rng, config.rng, config.seed, RNG_STREAM_WORLD);
+  World *world = create_guaranteed_world(config.width, config.height, config.obstacle_ratio, start, &rng);
+  Simulation *sim = world ? simulation_create_with_world(config, world) : NULL;
+  if (!sim) {
+    fprintf(stderr, "Svet sa nepodarilo vytvorit\n");
+    world_destroy(world);
+    return 2;
+  }
+
+  AnalyticSummary exact;
+  simulation_analytic(sim, start, &exact);
+  if (!exact.ready) {
+    fprintf(stderr, "Presne hodnoty sa pre tento svet nepocitaju\n");
+    simulation_destroy(sim);
+    return 2;
+  }
+  engine_run(sim, start, config.total_replications, 0, NULL);
+
+  const Statistics *stats = sim->stats;
+  double n = (double)stats->total_runs;
+  double sd = n > 1 ? sqrt(stats->m2_steps / (n - 1)) : 0;
+  int ok = 1;
+
+  // E[T] sa da porovnat s priemerom krokov, len ked ziadny beh nenarazil na K
+  if (stats->succ_runs == stats->total_runs) {
+    ok &= check("E[T]", exact.hitting_time, stats->mean_steps, sd / sqrt(n));
+  } else {
+    printf("%-22s presne %12.4f  (MC je orezane limitom K)\n", "E[T]", exact.hitting_time);
+  }
+
+  if (exact.distribution) {
+    double rate = n > 0 ? (double)stats->succ_runs / n : 0;
+    ok &= check("P(T <= K)", exact.rate, rate, sqrt(exact.rate * (1 - exact.rate) / n));
+    ok &= check("E[min(T, K)]", exact.mean_steps, stats->mean_steps, sd / sqrt(n));
+    // kvantil z histogramu je stred kosa, len na porovnanie okom
+    printf("%-22s presne %lld / %lld / %lld  MC %lld / %lld / %lld\n", "p50 / p90 / p99",
+           (long long)exact.p50, (long long)exact.p90, (long long)exact.p99,
+           (long long)stat_quantile(stats, 0.5), (long long)stat_quantile(stats, 0.9),
+           (long long)stat_quantile(stats, 0.99));
+  }
+
+  simulation_destroy(sim);
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,38 @@
+#include "../simulation/run_store.h"
+
+#include <stdio.h>
+#include <inttypes.h>
+
+// Export stlpcoveho suboru .runs do CSV, jeden riadok na beh.
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    fprintf(stderr, "Pouzitie: %s vstup.runs [vystup.csv]\n", argv[0]);
+    return 1;
+  }
+
+  RunReader reader;
+  if (!run_reader_open(&reader, argv[1])) {
+    fprintf(stderr, "Subor %s nie je platny .runs subor\n", argv[1]);
+    return 1;
+  }
+
+  FILE *out = argc > 2 ? fopen(argv[2], "w") : stdout;
+  if (!out) {
+    fprintf(stderr, "Nie je mozne otvorit %s\n", argv[2]);
+    run_reader_close(&reader);
+    return 1;
+  }
+
+  fprintf(out, "replication,start_x,start_y,steps,success,seed\n");
+  while (run_reader_next(&reader)) {
+    for (uint32_t i = 0; i < reader.rows; i++) {
+      fprintf(out, "%" PRIu64 ",%" PRId32 ",%" PRId32 ",%" PRId32 ",%u,%" PRIu64 "\n",
+              reader.replication[i], reader.start_x[i], reader.start_y[i],
+              reader.steps[i], (unsigned)reader.success[i], reader.seed[i]);
+    }
+  }
+
+  if (out != stdout) fclose(out);
+  run_reader_close(&reader);
+  return 0;
+}
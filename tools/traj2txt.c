@@ -0,0 +1,70 @@
+#include "../simulation/trajectory_bin.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+// Prevod binarneho .traj suboru do textoveho formatu simulation_run.
+// Bez cisla behu prevedie vsetky behy a prida SUMMARY, s cislom (od 1)
+// skoci cez index priamo na dany beh.
+int main(int argc, char **argv) {
+  if (argc < 3) {
+    fprintf(stderr, "Pouzitie: %s vstup.traj vystup.txt [beh]\n", argv[0]);
+    return 1;
+  }
+
+  TrajectoryReader reader;
+  if (!trajectory_reader_open(&reader, argv[1])) {
+    fprintf(stderr, "Subor %s nie je platny .traj subor\n", argv[1]);
+    return 1;
+  }
+
+  TrajectoryFile out;
+  if (!trajectory_file_open(&out, argv[2])) {
+    fprintf(stderr, "Nie je mozne otvorit %s\n", argv[2]);
+    trajectory_reader_close(&reader);
+    return 1;
+  }
+
+  uint64_t first = 0;
+  uint64_t last = reader.runs;
+  if (argc > 3) {
+    first = strtoull(argv[3], NULL, 10) - 1;
+    last = first + 1;
+    if (first >= reader.runs) {
+      fprintf(stderr, "Subor ma len %llu behov\n", (unsigned long long)reader.runs);
+      trajectory_file_close(&out);
+      trajectory_reader_close(&reader);
+      return 1;
+    }
+  }
+
+  long long total_steps = 0;
+  long long succ = 0;
+  int status = 0;
+  for (uint64_t n = first; n < last; n++) {
+    TrajectoryBinRecord rec;
+    if (!trajectory_reader_record(&reader, n, &rec) || !trajectory_reader_replay(&reader, n, &out.sink)) {
+      fprintf(stderr, "Beh %llu sa neda precitat\n", (unsigned long long)n + 1);
+      status = 1;
+      break;
+    }
+    total_steps += rec.steps;
+    succ += rec.success != 0;
+  }
+
+  if (argc <= 3 && status == 0) {
+    long long total = (long long)reader.runs;
+    double success_rate = total > 0 ? ((double)succ * 100.0) / (double)total : 0.0;
+    fprintf(out.out, "SUMMARY:\n");
+    fprintf(out.out, "total_runs=%lld succ_runs=%lld total_steps=%lld success_rate=%.2f\n",
+            total, succ, total_steps, success_rate);
+    fprintf(out.out, "EOF\n\n");
+  }
+
+  if (!trajectory_file_close(&out)) {
+    fprintf(stderr, "Zapis do %s zlyhal\n", argv[2]);
+    status = 1;
+  }
+  trajectory_reader_close(&reader);
+  return status;
+}